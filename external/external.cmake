@@ -78,24 +78,29 @@ if((NOT SPDLOG_INCLUDE_DIR) OR (NOT EXISTS ${SPDLOG_INCLUDE_DIR}))
 endif()
 install(DIRECTORY ${SPDLOG_INCLUDE_DIR}/spdlog DESTINATION ${include_dest})
 
-#
-# add ThreadPool
-#
-if((NOT THREADPOOL_INCLUDE_DIR) OR (NOT EXISTS ${THREADPOOL_INCLUDE_DIR}))
-    message("Unable to find ThreadPool, cloning...")
-    execute_process(COMMAND git submodule update --init -- external/ThreadPool
-                    WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR})
-    set(THREADPOOL_INCLUDE_DIR ${CMAKE_CURRENT_SOURCE_DIR}/external/ThreadPool
-        CACHE PATH "ThreadPool include directory")
-    # don't need to be installed
-endif()
-
 #
 # add cmark
 #
 find_library(CMARK_LIBRARY "cmark" "/usr/lib" "/usr/local/lib")
 find_path(CMARK_INCLUDE_DIR "cmark.h" "/usr/include" "/usr/local/include")
 
+# cmark_mem is required, it was added in 0.27
+if(CMARK_LIBRARY AND CMARK_INCLUDE_DIR)
+    set(cmark_version "")
+    if(EXISTS "${CMARK_INCLUDE_DIR}/cmark_version.h")
+        file(STRINGS "${CMARK_INCLUDE_DIR}/cmark_version.h" cmark_version_line
+             REGEX "#define CMARK_VERSION_STRING")
+        string(REGEX MATCH "[0-9]+\\.[0-9]+(\\.[0-9]+)?" cmark_version "${cmark_version_line}")
+    endif()
+    if((NOT cmark_version) OR (cmark_version VERSION_LESS "0.27"))
+        message("Installed cmark version ${cmark_version} is too old, at least 0.27 is required")
+        unset(CMARK_LIBRARY)
+        unset(CMARK_LIBRARY CACHE)
+        unset(CMARK_INCLUDE_DIR)
+        unset(CMARK_INCLUDE_DIR CACHE)
+    endif()
+endif()
+
 if((NOT CMARK_LIBRARY) OR (NOT CMARK_INCLUDE_DIR))
     message("Unable to find cmark, installing it myself...")
     execute_process(COMMAND git submodule update --init -- external/cmark
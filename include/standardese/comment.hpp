@@ -5,8 +5,8 @@
 #ifndef STANDARDESE_COMMENT_HPP_INCLUDED
 #define STANDARDESE_COMMENT_HPP_INCLUDED
 
-#include <map>
-#include <mutex>
+#include <atomic>
+#include <vector>
 
 #include <standardese/md_entity.hpp>
 #include <standardese/md_blocks.hpp>
@@ -81,15 +81,12 @@ namespace standardese
         friend detail::md_ptr_access;
     };
 
-    class comment_id;
-
     namespace detail
     {
-        struct comment_compare
-        {
-            bool operator()(const comment_id& id_a,
-                            const comment_id& id_b) const STANDARDESE_NOEXCEPT;
-        };
+        /// Returns the interned file name for the given path.
+        /// Only the file name of the path is used,
+        /// the same file name always yields the same pointer.
+        const char* intern_file_name(const char* path);
     } // namespace detail
 
     /// The identifier of a comment.
@@ -97,20 +94,22 @@ namespace standardese
     class comment_id
     {
     public:
-        comment_id(const string& file_name, unsigned line)
-        : file_name_or_name_(get_file_name(file_name.c_str())), line_(line)
+        comment_id(const char* file_name, unsigned line)
+        : file_name_(detail::intern_file_name(file_name)), name_(""), line_(line)
         {
             assert(line != 0u);
         }
 
-        comment_id(const string& file_name, unsigned line, const string& entity_name)
-        : file_name_or_name_('$' + get_file_name(file_name.c_str()) + '$' + entity_name.c_str()),
+        comment_id(const char* file_name, unsigned line, string entity_name)
+        : file_name_(detail::intern_file_name(file_name)),
+          name_(std::move(entity_name)),
           line_(line)
         {
             assert(line != 0u);
+            assert(!name_.empty());
         }
 
-        explicit comment_id(string name) : file_name_or_name_(std::move(name)), line_(0u)
+        explicit comment_id(string name) : file_name_(nullptr), name_(std::move(name)), line_(0u)
         {
         }
 
@@ -121,7 +120,7 @@ namespace standardese
 
         bool is_location() const STANDARDESE_NOEXCEPT
         {
-            return !is_name() && file_name_or_name_.c_str()[0] != '$';
+            return !is_name() && name_.empty();
         }
 
         bool is_inline_location() const STANDARDESE_NOEXCEPT
@@ -129,18 +128,12 @@ namespace standardese
             return !is_name() && !is_location();
         }
 
-        string file_name() const STANDARDESE_NOEXCEPT
+        /// \returns The interned file name,
+        /// ids of the same file always return the same pointer.
+        const char* file_name() const STANDARDESE_NOEXCEPT
         {
             assert(!is_name());
-            if (is_location())
-                return file_name_or_name_;
-
-            assert(is_inline_location());
-            std::string result;
-            for (auto ptr = file_name_or_name_.c_str() + 1; *ptr != '$'; ++ptr)
-                result += *ptr;
-
-            return result;
+            return file_name_;
         }
 
         unsigned line() const STANDARDESE_NOEXCEPT
@@ -149,32 +142,22 @@ namespace standardese
             return line_;
         }
 
-        string inline_entity_name() const STANDARDESE_NOEXCEPT
+        const string& inline_entity_name() const STANDARDESE_NOEXCEPT
         {
             assert(is_inline_location());
-            auto ptr = file_name_or_name_.c_str() + 1;
-            while (*ptr != '$')
-                ++ptr;
-            ++ptr;
-            return ptr;
+            return name_;
         }
 
         const string& unique_name() const STANDARDESE_NOEXCEPT
         {
             assert(is_name());
-            return file_name_or_name_;
+            return name_;
         }
 
     private:
-        std::string get_file_name(const std::string& path)
-        {
-            return path.substr(path.find_last_of("/\\:") + 1);
-        }
-
-        string   file_name_or_name_;
-        unsigned line_;
-
-        friend detail::comment_compare;
+        const char* file_name_;
+        string      name_;
+        unsigned    line_;
     };
 
     class comment
@@ -304,18 +287,53 @@ namespace standardese
                                const comment* c);
     }
 
+    /// Stores the comments of all files.
+    ///
+    /// The comments of a file are collected while it is parsed and registered all at once.
+    /// Location comments are stored in a table per file sorted by line,
+    /// comments referring to an entity by name in a separate hash table.
+    /// Both are immutable once registered, so looking up a comment is lock-free.
     class comment_registry
     {
     public:
-        bool register_comment(comment_id id, comment c) const;
+        using comment_list = std::vector<std::pair<comment_id, comment>>;
+
+        comment_registry() STANDARDESE_NOEXCEPT;
+
+        comment_registry(const comment_registry&) = delete;
+        comment_registry& operator=(const comment_registry&) = delete;
+
+        ~comment_registry() STANDARDESE_NOEXCEPT;
+
+        /// Registers all comments of a file.
+        /// If there is already a comment with the same id, the new one is ignored.
+        /// The comments referring to an entity by name are associated with `file_name`,
+        /// if it isn't `nullptr`.
+        void register_comments(comment_list comments, const char* file_name = nullptr) const;
+
+        /// \returns The comments referring to an entity by name that were registered for the file,
+        /// together with the name.
+        std::vector<std::pair<std::string, const comment*>> get_name_comments(
+            const char* file_name) const;
 
         const comment* lookup_comment(const cpp_entity& e, const doc_entity* parent) const;
 
         const comment* lookup_comment(const std::string& module) const;
 
     private:
-        mutable std::mutex mutex_;
-        mutable std::map<comment_id, comment, detail::comment_compare> comments_;
+        struct file_comments;
+        struct name_comment;
+
+        const comment* lookup_location(const comment_id& id, const cpp_entity& e,
+                                       const doc_entity* parent) const;
+
+        const comment* lookup_name(const char* name) const STANDARDESE_NOEXCEPT;
+
+        static const std::size_t no_file_shards = 64u;
+        static const std::size_t no_name_shards = 256u;
+
+        mutable std::atomic<file_comments*> files_[no_file_shards];
+        mutable std::atomic<name_comment*>  names_[no_name_shards];
     };
 
     class parser;
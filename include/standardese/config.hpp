@@ -6,6 +6,7 @@
 #define STANDARDESE_CONFIG_HPP_INCLUDED
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -33,9 +34,16 @@ namespace standardese
         count,
     };
 
+    namespace detail
+    {
+        class compile_commands;
+    } // namespace detail
+
     class compile_config
     {
     public:
+        // if commands_dir is given, the compilation database there is loaded
+        // and each file gets the flags of its command, see get_flags()
         compile_config(cpp_standard standard, string commands_dir = "");
 
         void add_macro_definition(string def);
@@ -59,21 +67,42 @@ namespace standardese
             return clang_binary_;
         }
 
-        std::vector<const char*> get_flags() const;
+        // whether or not the clang binary is used for preprocessing,
+        // by default it is only used if libclang cannot preprocess a file
+        void set_external_preprocessor(bool use) STANDARDESE_NOEXCEPT
+        {
+            external_preprocessor_ = use;
+        }
+
+        bool use_external_preprocessor() const STANDARDESE_NOEXCEPT
+        {
+            return external_preprocessor_;
+        }
 
-        std::vector<string>::const_iterator begin() const
+        // whether or not function bodies are parsed,
+        // by default they are skipped as they are not needed for the documentation
+        void set_parse_function_bodies(bool parse) STANDARDESE_NOEXCEPT
         {
-            return flags_.begin();
+            parse_function_bodies_ = parse;
         }
 
-        std::vector<string>::const_iterator end() const
+        bool parse_function_bodies() const STANDARDESE_NOEXCEPT
         {
-            return flags_.end();
+            return parse_function_bodies_;
         }
 
+        // flags for parsing the given file
+        // if there is a compilation database, they include the flags of the command for the file,
+        // or for headers the command of the nearest source file
+        std::vector<const char*> get_flags(const char* full_path) const;
+
     private:
-        std::vector<string> flags_;
-        std::string         clang_binary_;
+        std::vector<string>                             flags_;
+        std::shared_ptr<const detail::compile_commands> commands_;
+        std::size_t                                     commands_pos_;
+        std::string                                     clang_binary_;
+        bool                                            external_preprocessor_;
+        bool                                            parse_function_bodies_;
     };
 
     enum class command_type : unsigned;
@@ -5,6 +5,7 @@
 #ifndef STANDARDESE_CPP_ENTITY_HPP_INCLUDED
 #define STANDARDESE_CPP_ENTITY_HPP_INCLUDED
 
+#include <atomic>
 #include <cassert>
 #include <cstddef>
 #include <iterator>
@@ -23,11 +24,20 @@ namespace standardese
 
     using cpp_name = string;
 
-    template <typename T>
-    using cpp_ptr = std::unique_ptr<T>;
-
     class cpp_entity;
 
+    namespace detail
+    {
+        // destroys the entity and frees its memory, unless it belongs to an arena
+        struct cpp_entity_deleter
+        {
+            void operator()(cpp_entity* entity) const STANDARDESE_NOEXCEPT;
+        };
+    } // namespace detail
+
+    template <typename T>
+    using cpp_ptr = std::unique_ptr<T, detail::cpp_entity_deleter>;
+
     using cpp_entity_ptr = cpp_ptr<cpp_entity>;
 
     class cpp_entity
@@ -97,6 +107,14 @@ namespace standardese
 
         cpp_entity& operator=(cpp_entity&&) = delete;
 
+        // entities are allocated in the arena of the file currently being parsed, if any,
+        // see [standardese::detail::memory_arena_scope]()
+        // they must be destroyed through a cpp_ptr,
+        // operator delete is only used if a constructor throws
+        static void* operator new(std::size_t size);
+
+        static void operator delete(void* ptr) STANDARDESE_NOEXCEPT;
+
         /// \returns The name of the entity as specified in the source.
         virtual cpp_name get_name() const;
 
@@ -111,6 +129,8 @@ namespace standardese
         }
 
         /// \returns A unique name describing one entity.
+        /// \notes The name is computed once and then stored as [standardese::interned_string](),
+        /// so it must only be called after the entity has been parsed completely.
         cpp_name get_unique_name(bool exclude_scope = false) const;
 
         /// \returns The type of the entity.
@@ -168,11 +188,16 @@ namespace standardese
         cpp_entity_ptr    next_;
         const cpp_entity* parent_;
         type              t_;
+        bool              in_arena_;
+
+        // cached result of get_unique_name(), with and without scope
+        mutable std::atomic<const detail::interned_node*> unique_name_, scoped_unique_name_;
 
         template <typename T, class Base, template <typename> class Ptr>
         friend class detail::entity_container;
         template <typename T>
         friend class cpp_entity_container;
+        friend detail::cpp_entity_deleter;
     };
 
     inline bool is_preprocessor(cpp_entity::type t) STANDARDESE_NOEXCEPT
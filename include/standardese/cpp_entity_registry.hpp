@@ -5,7 +5,7 @@
 #ifndef STANDARDESE_CPP_ENTITY_REGISTRY_HPP_INCLUDED
 #define STANDARDESE_CPP_ENTITY_REGISTRY_HPP_INCLUDED
 
-#include <mutex>
+#include <atomic>
 #include <unordered_map>
 
 #include <standardese/detail/parse_utils.hpp>
@@ -13,31 +13,38 @@
 
 namespace standardese
 {
+    /// Maps cursors to the entities parsed from them.
+    ///
+    /// The entities of a translation unit are collected locally while it is parsed
+    /// and registered all at once at the end.
+    /// Each translation unit gets its own immutable table, which are stored in shards.
+    /// Registering takes no lock and looking up an entity is lock-free.
     class cpp_entity_registry
     {
     public:
-        void register_entity(const cpp_entity& e) const
-        {
-            std::unique_lock<std::mutex> lock(mutex_);
-            map_.emplace(e.get_cursor(), &e);
-        }
+        using entity_map = std::unordered_map<cpp_cursor, const cpp_entity*>;
 
-        const cpp_entity& lookup_entity(const cpp_cursor& cur) const
-        {
-            std::unique_lock<std::mutex> lock(mutex_);
-            return *map_.at(cur);
-        }
+        cpp_entity_registry() STANDARDESE_NOEXCEPT;
 
-        const cpp_entity* try_lookup(const cpp_cursor& cur) const STANDARDESE_NOEXCEPT
-        {
-            std::unique_lock<std::mutex> lock(mutex_);
-            auto                         iter = map_.find(cur);
-            return iter == map_.end() ? nullptr : iter->second;
-        }
+        cpp_entity_registry(const cpp_entity_registry&) = delete;
+        cpp_entity_registry& operator=(const cpp_entity_registry&) = delete;
+
+        ~cpp_entity_registry() STANDARDESE_NOEXCEPT;
+
+        /// Registers all entities of a translation unit.
+        /// It must be called at most once per translation unit.
+        void register_entities(CXTranslationUnit tu, entity_map entities) const;
+
+        const cpp_entity& lookup_entity(const cpp_cursor& cur) const;
+
+        const cpp_entity* try_lookup(const cpp_cursor& cur) const STANDARDESE_NOEXCEPT;
 
     private:
-        mutable std::mutex mutex_, mutex_alternatives_;
-        mutable std::unordered_map<cpp_cursor, const cpp_entity*> map_;
+        struct tu_entities;
+
+        static const std::size_t no_shards = 64u;
+
+        mutable std::atomic<tu_entities*> shards_[no_shards];
     };
 
     template <CXCursorKind Kind>
@@ -7,6 +7,7 @@
 
 #include <string>
 #include <unordered_set>
+#include <vector>
 
 #include <standardese/cpp_entity.hpp>
 #include <standardese/noexcept.hpp>
@@ -133,13 +134,17 @@ namespace standardese
     class preprocessor
     {
     public:
+        // tu is an optional translation unit of the file that is reparsed with the result
         std::string preprocess(const parser& p, const compile_config& c, const char* full_path,
-                               cpp_file& file) const;
+                               cpp_file& file, CXTranslationUnit tu = nullptr) const;
 
         void whitelist_include_dir(std::string dir);
 
         bool is_whitelisted_directory(std::string& dir) const STANDARDESE_NOEXCEPT;
 
+        // sorted
+        std::vector<std::string> get_whitelisted_directories() const;
+
     private:
         std::unordered_set<std::string> include_dirs_;
     };
@@ -0,0 +1,89 @@
+// Copyright (C) 2016 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#ifndef STANDARDESE_DETAIL_MEMORY_ARENA_HPP_INCLUDED
+#define STANDARDESE_DETAIL_MEMORY_ARENA_HPP_INCLUDED
+
+#include <cstddef>
+
+#include <standardese/noexcept.hpp>
+
+namespace standardese
+{
+    namespace detail
+    {
+        // the entities that can be allocated in an arena,
+        // each has its own current arena
+        enum class arena_kind
+        {
+            cpp_entity,
+            md_entity,
+
+            count
+        };
+
+        // monotonic allocator, memory is only freed when the arena is destroyed
+        // it must only be used by one thread at a time
+        class memory_arena
+        {
+        public:
+            memory_arena() STANDARDESE_NOEXCEPT : head_(nullptr), cur_(nullptr), end_(nullptr)
+            {
+            }
+
+            memory_arena(const memory_arena&) = delete;
+            memory_arena& operator=(const memory_arena&) = delete;
+
+            ~memory_arena() STANDARDESE_NOEXCEPT;
+
+            void* allocate(std::size_t size, std::size_t alignment);
+
+            // whether ptr points into the block the arena currently allocates from,
+            // only checks that block so that it is cheap
+            bool in_current_block(const void* ptr) const STANDARDESE_NOEXCEPT;
+
+            // the arena set for the current thread, if any
+            static memory_arena* get_current(arena_kind kind) STANDARDESE_NOEXCEPT;
+
+        private:
+            struct block;
+
+            // returns the memory after the block header
+            char* new_block(std::size_t size);
+
+            block* head_;
+            char*  cur_;
+            char*  end_;
+        };
+
+        // sets the arena of the current thread for its lifetime,
+        // a null arena makes allocations use the heap
+        class memory_arena_scope
+        {
+        public:
+            memory_arena_scope(arena_kind kind, memory_arena* arena) STANDARDESE_NOEXCEPT;
+
+            memory_arena_scope(const memory_arena_scope&) = delete;
+            memory_arena_scope& operator=(const memory_arena_scope&) = delete;
+
+            ~memory_arena_scope() STANDARDESE_NOEXCEPT;
+
+        private:
+            memory_arena* prev_;
+            arena_kind    kind_;
+        };
+
+        // allocates memory from the current arena or the heap if there is none
+        // the memory must be freed with arena_deallocate(),
+        // which only frees it if it came from the heap
+        void* arena_allocate(arena_kind kind, std::size_t size);
+
+        // like realloc(), copies the old memory into new memory from the current arena or the heap
+        void* arena_reallocate(arena_kind kind, void* ptr, std::size_t size);
+
+        void arena_deallocate(void* ptr) STANDARDESE_NOEXCEPT;
+    }
+} // namespace standardese::detail
+
+#endif // STANDARDESE_DETAIL_MEMORY_ARENA_HPP_INCLUDED
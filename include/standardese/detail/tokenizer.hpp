@@ -6,7 +6,10 @@
 #define STANDARDESE_DETAIL_TOKENIZER_HPP_INCLUDED
 
 #include <initializer_list>
+#include <memory>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 #include <standardese/detail/sequence_stream.hpp>
 #include <standardese/string.hpp>
@@ -31,25 +34,20 @@ namespace standardese
         class token
         {
         public:
-            token() : token("", CXToken_Punctuation)
+            token() : token(get_static_spelling(""), CXToken_Punctuation)
             {
             }
 
-            token(string value, CXTokenKind kind, unsigned offset = 0)
-            : value_(value), kind_(kind), offset_(offset)
+            // value must outlive the token,
+            // it is usually owned by a token_buffer
+            token(const string& value, CXTokenKind kind, unsigned offset = 0)
+            : value_(&value), kind_(kind), offset_(offset)
             {
             }
 
-            token(CXTranslationUnit tu, CXToken token);
-
-            const token* operator->() const STANDARDESE_NOEXCEPT
+            const string& get_value() const STANDARDESE_NOEXCEPT
             {
-                return this;
-            }
-
-            string get_value() const STANDARDESE_NOEXCEPT
-            {
-                return value_;
+                return *value_;
             }
 
             CXTokenKind get_kind() const STANDARDESE_NOEXCEPT
@@ -62,173 +60,77 @@ namespace standardese
                 return offset_;
             }
 
+            // returns the spelling of the end tokens ";", "{" or of the empty token ""
+            static const string& get_static_spelling(const char* str);
+
         private:
-            string      value_;
-            CXTokenKind kind_;
-            unsigned    offset_;
+            const string* value_;
+            CXTokenKind   kind_;
+            unsigned      offset_;
         };
 
-        class token_iterator : public std::iterator<std::random_access_iterator_tag, token>
+        // the tokens of a range of a file, sorted by offset
+        // each distinct spelling is only stored once,
+        // so tokens are cheap to copy and never allocate
+        class token_buffer
         {
         public:
-            token operator*() const STANDARDESE_NOEXCEPT
-            {
-                return token(tu_, *cx_token_);
-            }
+            token_buffer(CXTranslationUnit tu, CXSourceRange range);
 
-            token operator->() const STANDARDESE_NOEXCEPT
-            {
-                return token(tu_, *cx_token_);
-            }
+            token_buffer(const token_buffer&) = delete;
+            token_buffer& operator=(const token_buffer&) = delete;
 
-            token_iterator& operator++() STANDARDESE_NOEXCEPT
+            const token* begin() const STANDARDESE_NOEXCEPT
             {
-                ++cx_token_;
-                return *this;
+                return tokens_.data();
             }
 
-            token_iterator operator++(int)STANDARDESE_NOEXCEPT
+            const token* end() const STANDARDESE_NOEXCEPT
             {
-                token_iterator tmp(*this);
-                ++*this;
-                return tmp;
+                return tokens_.data() + tokens_.size();
             }
 
-            token_iterator& operator--() STANDARDESE_NOEXCEPT
-            {
-                --cx_token_;
-                return *this;
-            }
-
-            token_iterator operator--(int)STANDARDESE_NOEXCEPT
-            {
-                token_iterator tmp(*this);
-                --*this;
-                return tmp;
-            }
+            // returns the first token at or after the offset
+            const token* lower_bound(unsigned offset) const STANDARDESE_NOEXCEPT;
 
-            token_iterator& operator+=(std::ptrdiff_t d) STANDARDESE_NOEXCEPT
-            {
-                cx_token_ += d;
-                return *this;
-            }
-
-            token_iterator& operator-=(std::ptrdiff_t d) STANDARDESE_NOEXCEPT
-            {
-                cx_token_ -= d;
-                return *this;
-            }
-
-            token operator[](std::ptrdiff_t d) const STANDARDESE_NOEXCEPT
-            {
-                return token(tu_, cx_token_[d]);
-            }
-
-            friend bool operator==(const token_iterator& a,
-                                   const token_iterator& b) STANDARDESE_NOEXCEPT
-            {
-                return a.cx_token_ == b.cx_token_;
-            }
-
-            friend bool operator!=(const token_iterator& a,
-                                   const token_iterator& b) STANDARDESE_NOEXCEPT
-            {
-                return !(a == b);
-            }
-
-            friend token_iterator operator+(const token_iterator& iter,
-                                            std::ptrdiff_t        d) STANDARDESE_NOEXCEPT
-            {
-                return token_iterator(iter.tu_, iter.cx_token_ + d);
-            }
-
-            friend token_iterator operator+(std::ptrdiff_t        d,
-                                            const token_iterator& iter) STANDARDESE_NOEXCEPT
-            {
-                return iter + d;
-            }
-
-            friend token_iterator operator-(const token_iterator& iter,
-                                            std::ptrdiff_t        d) STANDARDESE_NOEXCEPT
-            {
-                return token_iterator(iter.tu_, iter.cx_token_ - d);
-            }
-
-            friend token_iterator operator-(std::ptrdiff_t        d,
-                                            const token_iterator& iter) STANDARDESE_NOEXCEPT
-            {
-                return iter - d;
-            }
-
-            friend std::ptrdiff_t operator-(const token_iterator& a,
-                                            const token_iterator& b) STANDARDESE_NOEXCEPT
-            {
-                return a.cx_token_ - b.cx_token_;
-            }
-
-            friend bool operator<(const token_iterator& lhs, const token_iterator& rhs)
-            {
-                return lhs.cx_token_ < rhs.cx_token_;
-            }
-
-            friend bool operator>(const token_iterator& lhs, const token_iterator& rhs)
-            {
-                return rhs < lhs;
-            }
-
-            friend bool operator<=(const token_iterator& lhs, const token_iterator& rhs)
-            {
-                return !(rhs < lhs);
-            }
-
-            friend bool operator>=(const token_iterator& lhs, const token_iterator& rhs)
-            {
-                return !(lhs < rhs);
-            }
+            // returns the first token after the offset
+            const token* upper_bound(unsigned offset) const STANDARDESE_NOEXCEPT;
 
         private:
-            token_iterator(CXTranslationUnit tu, CXToken* token) STANDARDESE_NOEXCEPT
-                : tu_(tu),
-                  cx_token_(token)
+            struct spelling_hash
             {
-            }
-
-            CXTranslationUnit tu_;
-            CXToken*          cx_token_;
+                std::size_t operator()(const string& str) const STANDARDESE_NOEXCEPT;
+            };
 
-            friend class tokenizer;
+            std::vector<token>                        tokens_;
+            std::unordered_set<string, spelling_hash> spellings_;
         };
 
+        using token_iterator = const token*;
+
+        // the tokens of a cursor, a range of the token buffer of the file
         class tokenizer
         {
         public:
+            // tokenizes the cursor on its own
             tokenizer(CXTranslationUnit tu, CXFile file, cpp_cursor cur);
 
-            tokenizer(const translation_unit& tu, cpp_cursor cur)
-            : tokenizer(tu.get_cxunit(), tu.get_cxfile(), cur)
-            {
-            }
-
-            tokenizer(tokenizer&& other) STANDARDESE_NOEXCEPT : tu_(other.tu_),
-                                                                file_(other.file_),
-                                                                tokens_(other.tokens_),
-                                                                no_tokens_(other.no_tokens_),
-                                                                end_offset_(other.end_offset_),
-                                                                end_(other.end_)
-            {
-                other.tokens_ = nullptr;
-            }
+            // uses the tokens of the file
+            tokenizer(const translation_unit& tu, cpp_cursor cur);
 
-            ~tokenizer() STANDARDESE_NOEXCEPT;
+            tokenizer(tokenizer&&) = default;
 
             tokenizer& operator=(tokenizer&&) = delete;
 
             token_iterator begin() const STANDARDESE_NOEXCEPT
             {
-                return token_iterator(get_cxunit(), tokens_);
+                return begin_;
             }
 
-            token_iterator end() const STANDARDESE_NOEXCEPT;
+            token_iterator end() const STANDARDESE_NOEXCEPT
+            {
+                return end_;
+            }
 
             // returns whether two '>' characters at the end were munched into a single '>>'
             // only necessary for template parameter
@@ -246,15 +148,18 @@ namespace standardese
 
             token end_token() const STANDARDESE_NOEXCEPT
             {
-                return token(end_, CXToken_Punctuation);
+                return token(*end_token_, CXToken_Punctuation);
             }
 
         private:
-            CXTranslationUnit tu_;
-            CXFile            file_;
-            CXToken*          tokens_;
-            unsigned          no_tokens_, end_offset_;
-            const char*       end_;
+            void init(const token_buffer& buffer, CXSourceRange extent, const char* end_token);
+
+            CXTranslationUnit             tu_;
+            CXFile                        file_;
+            std::unique_ptr<token_buffer> own_buffer_;
+            token_iterator                begin_, end_;
+            unsigned                      end_offset_;
+            const string*                 end_token_;
         };
 
         using token_stream = sequence_stream<token_iterator>;
@@ -286,7 +191,7 @@ namespace standardese
             auto expr_bracket  = 0;
             while (bracket_count != 0 || expr_bracket != 0)
             {
-                auto spelling = stream.get().get_value();
+                auto& spelling = stream.get().get_value();
                 if (expr_bracket == 0 && spelling == open)
                     ++bracket_count;
                 else if (expr_bracket == 0 && spelling == close)
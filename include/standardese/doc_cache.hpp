@@ -0,0 +1,73 @@
+// Copyright (C) 2016 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#ifndef STANDARDESE_DOC_CACHE_HPP_INCLUDED
+#define STANDARDESE_DOC_CACHE_HPP_INCLUDED
+
+#include <atomic>
+#include <string>
+
+#include <standardese/noexcept.hpp>
+
+namespace standardese
+{
+    class compile_config;
+    class index;
+    class parser;
+    class translation_unit;
+    struct documentation;
+
+    /// Stores the generated documentation of files in a directory,
+    /// so that unchanged files don't need to be parsed again in the next run.
+    ///
+    /// An entry belongs to a file, the compilation flags and the configuration.
+    /// It is valid as long as neither the file nor any whitelisted header it includes changes.
+    /// It can be used from multiple threads.
+    class doc_cache
+    {
+    public:
+        /// The entries are stored in the given directory, it will be created if needed.
+        /// `configuration` must describe all options that affect the generated documentation,
+        /// entries created with a different configuration are ignored.
+        doc_cache(std::string directory, std::string configuration);
+
+        doc_cache(const doc_cache&) = delete;
+        doc_cache& operator=(const doc_cache&) = delete;
+
+        /// Returns the cached documentation of the given file,
+        /// or `documentation(nullptr, nullptr)` if there is no valid entry.
+        /// On success all entities are registered in the index,
+        /// as if the documentation was generated by [standardese::generate_doc_file]().
+        /// \notes The entities of cached documentation can be used for linking and the indices,
+        /// but they can't generate documentation or synopsis themselves.
+        documentation lookup(const parser& p, const index& i, const compile_config& c,
+                             const char* full_path, const std::string& output_name);
+
+        /// Stores the documentation generated for the given translation unit.
+        /// Failure to write the entry is logged but otherwise ignored.
+        void store(const parser& p, const compile_config& c, const translation_unit& tu,
+                   const std::string& output_name, const documentation& doc);
+
+        /// Returns the number of files whose documentation was found in the cache.
+        unsigned get_hit_count() const STANDARDESE_NOEXCEPT
+        {
+            return hits_;
+        }
+
+        /// Returns the number of files that had to be parsed.
+        unsigned get_miss_count() const STANDARDESE_NOEXCEPT
+        {
+            return misses_;
+        }
+
+    private:
+        std::string get_entry_path(const compile_config& c, const char* full_path,
+                                   const std::string& output_name) const;
+
+        std::string           directory_, configuration_;
+        std::atomic<unsigned> hits_, misses_;
+    };
+} // namespace standardese
+
+#endif // STANDARDESE_DOC_CACHE_HPP_INCLUDED
@@ -479,6 +479,7 @@ namespace standardese
         std::string                       output_name_;
 
         friend detail::doc_ptr_access;
+        friend class doc_cache;
     };
 } // namespace standardese
 
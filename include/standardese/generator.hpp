@@ -32,6 +32,11 @@ namespace standardese
     documentation generate_doc_file(const parser& p, const index& i, const cpp_file& f,
                                     std::string name);
 
+    // generates the document of a file returned by generate_doc_file() again,
+    // e.g. after it was released to save memory
+    md_ptr<md_document> generate_doc_document(const parser& p, const index& i,
+                                              const doc_entity& file);
+
     class doc_index final : public doc_entity
     {
     protected:
@@ -8,6 +8,7 @@
 #include <map>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <standardese/doc_entity.hpp>
@@ -27,12 +28,30 @@ namespace standardese
 
     class cpp_namespace;
 
+    /// Maps the unique names of all documented entities to their documentation.
+    ///
+    /// Entities are registered from multiple threads while the documentation is generated.
+    /// Once that is finished, `freeze()` turns the index into an immutable table,
+    /// afterwards lookups take no lock and don't allocate.
     class index
     {
     public:
+        index() STANDARDESE_NOEXCEPT : frozen_(false)
+        {
+        }
+
         void register_entity(const parser& p, const doc_entity& entity,
                              std::string output_name) const;
 
+        /// \effects Makes the index immutable, no more entities can be registered afterwards.
+        /// \notes It must not be called concurrently with any other member function.
+        void freeze();
+
+        bool is_frozen() const STANDARDESE_NOEXCEPT
+        {
+            return frozen_;
+        }
+
         const doc_entity* try_lookup(const std::string& unique_name) const;
 
         const doc_entity& lookup(const std::string& unique_name) const;
@@ -47,8 +66,8 @@ namespace standardese
         template <typename Func>
         void for_each_file(Func f)
         {
-            for (auto& iter : files_)
-                f(*iter->second.second);
+            for (auto& file : files_)
+                f(*file.second);
         }
 
         // void(const doc_entity* ns, const doc_entity& member)
@@ -85,10 +104,40 @@ namespace standardese
 
         void namespace_member_impl(ns_member_cb cb, void* data);
 
+        struct entry
+        {
+            std::string       id;
+            const doc_entity* entity;
+            std::size_t       hash;
+            bool              is_short;
+        };
+
+        // the id of an entity when used as scope of a relative name,
+        // unlike the regular id it keeps a trailing ()
+        struct scope
+        {
+            std::string id;
+            std::size_t hash;
+        };
+
+        class id_view;
+
+        const doc_entity* lookup_id(std::size_t hash, const id_view& id) const
+            STANDARDESE_NOEXCEPT;
+
+        const doc_entity* lookup_relative(const doc_entity& scope, const char* separator,
+                                          const char* name) const;
+
         mutable std::mutex mutex_;
         mutable std::map<std::string, std::pair<bool, const doc_entity*>> entities_;
-        mutable std::vector<decltype(entities_)::const_iterator> files_;
-        mutable std::vector<std::string>                         modules_;
+        mutable std::vector<std::pair<std::string, const doc_entity*>>    files_;
+        mutable std::vector<std::string>                                  modules_;
+        mutable std::unordered_map<const doc_entity*, scope>              scopes_;
+
+        // only used after freeze()
+        std::vector<entry>       table_;   // sorted by id
+        std::vector<std::size_t> buckets_; // hash table of indices into table_, 0 means empty
+        bool                     frozen_;
 
         linker linker_;
     };
@@ -18,6 +18,10 @@ namespace standardese
     class linker
     {
     public:
+        linker() STANDARDESE_NOEXCEPT : frozen_(false)
+        {
+        }
+
         /// \effects Registers an external URL.
         /// All unresolved `unique-name`s starting with `prefix` will be resolved to `url`.
         /// If `url` contains two dollar signs (`$$`), this will be replaced by the (url-encoded) `unique-name`.
@@ -29,6 +33,19 @@ namespace standardese
 
         void change_output_file(const doc_entity& e, std::string output_file) const;
 
+        /// \effects Makes the linker immutable,
+        /// afterwards nothing can be registered or changed and getting URLs takes no lock.
+        /// \notes It must not be called concurrently with any other member function.
+        void freeze() STANDARDESE_NOEXCEPT
+        {
+            frozen_ = true;
+        }
+
+        bool is_frozen() const STANDARDESE_NOEXCEPT
+        {
+            return frozen_;
+        }
+
         std::string get_url(const index& idx, const doc_entity* context,
                             const std::string& unique_name, const char* extension) const;
 
@@ -39,6 +56,8 @@ namespace standardese
         md_ptr<md_anchor> get_anchor(const doc_entity& e, const md_entity& parent) const;
 
     private:
+        std::unique_lock<std::mutex> lock() const;
+
         class location
         {
         public:
@@ -66,6 +85,7 @@ namespace standardese
         mutable std::unordered_map<std::string, location>       anchors_;
 
         std::unordered_map<std::string, std::string> external_;
+        bool                                         frozen_;
     };
 } // namespace standardese
 
@@ -57,6 +57,10 @@ namespace standardese
 
         void set_section_type(section_type t, const std::string& name);
 
+        /// Returns the name of the section shown in front of the paragraph.
+        /// Only valid if the section type isn't invalid.
+        const char* get_section_text() const STANDARDESE_NOEXCEPT;
+
     protected:
         md_entity_ptr do_clone(const md_entity* parent) const override;
 
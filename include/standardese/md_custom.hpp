@@ -5,6 +5,7 @@
 #ifndef STANDARDESE_MD_CUSTOM_HPP_INCLUDED
 #define STANDARDESE_MD_CUSTOM_HPP_INCLUDED
 
+#include <standardese/detail/memory_arena.hpp>
 #include <standardese/md_entity.hpp>
 
 namespace standardese
@@ -58,7 +59,16 @@ namespace standardese
         friend detail::md_ptr_access;
     };
 
-    class md_document final : public md_container
+    namespace detail
+    {
+        // a base class, so that the arena is destroyed after the entities of the document
+        struct md_document_arena
+        {
+            mutable memory_arena arena;
+        };
+    } // namespace detail
+
+    class md_document final : private detail::md_document_arena, public md_container
     {
     public:
         static md_entity::type get_entity_type() STANDARDESE_NOEXCEPT
@@ -90,6 +100,7 @@ namespace standardese
         std::string name_;
 
         friend detail::md_ptr_access;
+        friend detail::md_arena_scope;
     };
 } // namespace standardese
 
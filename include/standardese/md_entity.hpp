@@ -5,13 +5,16 @@
 #ifndef STANDARDESE_MD_ENTITY_HPP_INCLUDED
 #define STANDARDESE_MD_ENTITY_HPP_INCLUDED
 
+#include <cstddef>
 #include <memory>
 
 #include <standardese/detail/entity_container.hpp>
+#include <standardese/detail/memory_arena.hpp>
 #include <standardese/string.hpp>
 
 extern "C" {
 typedef struct cmark_node cmark_node;
+typedef struct cmark_mem  cmark_mem;
 }
 
 namespace standardese
@@ -72,6 +75,13 @@ namespace standardese
 
         md_entity& operator=(const md_entity&) = delete;
 
+        // entities made or cloned as part of a document are allocated in its arena,
+        // all others - like comments - use the heap
+        // see [standardese::detail::md_arena_scope]()
+        static void* operator new(std::size_t size);
+
+        static void operator delete(void* ptr) STANDARDESE_NOEXCEPT;
+
         type get_entity_type() const STANDARDESE_NOEXCEPT
         {
             return type_;
@@ -93,10 +103,7 @@ namespace standardese
             return *parent_;
         }
 
-        md_entity_ptr clone(const md_entity& parent) const
-        {
-            return do_clone(&parent);
-        }
+        md_entity_ptr clone(const md_entity& parent) const;
 
     protected:
         md_entity(type t, cmark_node* node, const md_entity& parent) STANDARDESE_NOEXCEPT
@@ -196,6 +203,24 @@ namespace standardese
 
     namespace detail
     {
+        // the allocator that must be used for all cmark nodes and parsers
+        // it uses the arena of the document currently made or cloned into, if any
+        cmark_mem* get_cmark_mem() STANDARDESE_NOEXCEPT;
+
+        // sets the arena of the document parent belongs to for its lifetime,
+        // or the heap if parent isn't part of a document
+        // it must be active while an entity with that parent is created
+        class md_arena_scope
+        {
+        public:
+            explicit md_arena_scope(const md_entity& parent) STANDARDESE_NOEXCEPT;
+
+        private:
+            static memory_arena* get_arena(const md_entity& parent) STANDARDESE_NOEXCEPT;
+
+            memory_arena_scope scope_;
+        };
+
         struct md_ptr_access
         {
             template <typename T, typename... Args>
@@ -8,6 +8,7 @@
 #include <cstring>
 #include <string>
 #include <ostream>
+#include <vector>
 
 #include <standardese/md_blocks.hpp>
 #include <standardese/noexcept.hpp>
@@ -130,6 +131,11 @@ namespace standardese
     void normalize_urls(const index& idx, md_container& doc,
                         const doc_entity* default_context = nullptr);
 
+    /// Returns the URLs the links to entities in the document resolve to, in order.
+    /// Links that can't be resolved give an empty string.
+    std::vector<std::string> get_entity_urls(const index& idx, const md_document& doc,
+                                             const char* extension);
+
     struct raw_document
     {
         path        file_name;
@@ -149,11 +155,23 @@ namespace standardese
         {
         }
 
-        void render(const std::shared_ptr<spdlog::logger>& logger, const md_document& document,
+        /// Writes the document to a file.
+        /// The links to entities are resolved in place for the duration of the call.
+        /// Concurrent calls for the same document are serialized,
+        /// but the document must not be read by other threads meanwhile.
+        void render(const std::shared_ptr<spdlog::logger>& logger, md_document& document,
                     const char* output_extension = nullptr);
 
+        /// Writes the document using each of the outputs, in order.
+        /// The links are resolved only once for all outputs that use the same link extension,
+        /// otherwise it is the same as calling [standardese::output::render]() for each of them.
+        /// Use it instead of rendering the same document from multiple jobs.
+        static void render(const std::shared_ptr<spdlog::logger>& logger, md_document& document,
+                           const std::vector<output>& outputs,
+                           const char* output_extension = nullptr);
+
         void render_template(const std::shared_ptr<spdlog::logger>& logger,
-                             const template_file& templ, const documentation& doc,
+                             const compiled_template& templ, const documentation& doc,
                              const char* output_extension = nullptr);
 
         void render_raw(const std::shared_ptr<spdlog::logger>& logger, const raw_document& document,
@@ -170,6 +188,8 @@ namespace standardese
         }
 
     private:
+        void write(const md_document& document, const char* output_extension) const;
+
         path                prefix_;
         output_format_base* format_;
         const parser*       parser_;
@@ -7,6 +7,7 @@
 
 #include <cassert>
 #include <fstream>
+#include <memory>
 #include <ostream>
 
 #include <standardese/noexcept.hpp>
@@ -51,7 +52,8 @@ namespace standardese
         void unindent(unsigned width);
 
     private:
-        virtual void do_write_char(char c) = 0;
+        // writes the characters as-is, they don't contain indentation
+        virtual void do_write(const char* str, std::size_t n) = 0;
 
         virtual char undo_write()
         {
@@ -77,9 +79,9 @@ namespace standardese
         }
 
     private:
-        void do_write_char(char c) override
+        void do_write(const char* str, std::size_t n) override
         {
-            buffer_->sputc(c);
+            buffer_->sputn(str, std::streamsize(n));
         }
 
         std::streambuf* buffer_;
@@ -88,18 +90,17 @@ namespace standardese
     class file_output : public output_stream_base
     {
     public:
-        file_output(const std::string& file) STANDARDESE_NOEXCEPT : file_(file)
-        {
-            assert(file_.is_open());
-        }
+        file_output(const std::string& file);
 
     private:
-        void do_write_char(char c) override
+        void do_write(const char* str, std::size_t n) override
         {
-            file_.rdbuf()->sputc(c);
+            // big writes bypass the buffer
+            file_.rdbuf()->sputn(str, std::streamsize(n));
         }
 
-        std::ofstream file_;
+        std::unique_ptr<char[]> buffer_;
+        std::ofstream           file_;
     };
 
     class string_output : public output_stream_base
@@ -115,9 +116,9 @@ namespace standardese
         }
 
     private:
-        void do_write_char(char c) override
+        void do_write(const char* str, std::size_t n) override
         {
-            str_.push_back(c);
+            str_.append(str, n);
         }
 
         char undo_write() override
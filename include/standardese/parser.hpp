@@ -7,6 +7,7 @@
 
 #include <clang-c/Index.h>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -30,6 +31,7 @@
 
 namespace standardese
 {
+    class preamble_cache;
     class translation_unit;
 
     namespace detail
@@ -140,6 +142,16 @@ namespace standardese
             return index_.get();
         }
 
+        /// Enables sharing of precompiled headers between files starting with the same includes.
+        /// They are stored in the given directory.
+        void enable_preamble_cache(std::string directory);
+
+        /// Returns the preamble cache or `nullptr` if it isn't enabled.
+        const preamble_cache* get_preamble_cache() const STANDARDESE_NOEXCEPT
+        {
+            return preamble_cache_.get();
+        }
+
     private:
         struct deleter
         {
@@ -156,6 +168,7 @@ namespace standardese
         preprocessor preprocessor_;
 
         detail::wrapper<CXIndex, deleter> index_;
+        std::unique_ptr<preamble_cache>   preamble_cache_;
         std::shared_ptr<spdlog::logger> logger_;
         detail::file_container          files_;
     };
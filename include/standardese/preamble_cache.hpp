@@ -0,0 +1,66 @@
+// Copyright (C) 2016 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#ifndef STANDARDESE_PREAMBLE_CACHE_HPP_INCLUDED
+#define STANDARDESE_PREAMBLE_CACHE_HPP_INCLUDED
+
+#include <atomic>
+#include <clang-c/Index.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <standardese/noexcept.hpp>
+
+namespace standardese
+{
+    /// Shares precompiled headers between files starting with the same includes.
+    /// The includes at the beginning of a preprocessed file are its preamble.
+    /// Once a second file with the same preamble and compilation flags is parsed,
+    /// the preamble is precompiled and used for it and all following ones.
+    /// It can be used from multiple threads.
+    class preamble_cache
+    {
+    public:
+        /// The precompiled headers are written into the given directory,
+        /// it will be created if needed.
+        /// They are removed again on destruction.
+        explicit preamble_cache(std::string directory);
+
+        preamble_cache(const preamble_cache&) = delete;
+        preamble_cache& operator=(const preamble_cache&) = delete;
+
+        ~preamble_cache() STANDARDESE_NOEXCEPT;
+
+        /// Returns the path to the precompiled header to use for the preprocessed source
+        /// parsed with the given arguments.
+        /// Returns an empty string if there is none.
+        std::string lookup(CXIndex index, const std::vector<const char*>& args,
+                           const std::string& source);
+
+        /// Returns the number of files that could use a precompiled header.
+        unsigned get_hit_count() const STANDARDESE_NOEXCEPT
+        {
+            return hits_;
+        }
+
+        /// Returns the number of files with a preamble that couldn't use a precompiled header.
+        unsigned get_miss_count() const STANDARDESE_NOEXCEPT
+        {
+            return misses_;
+        }
+
+    private:
+        struct entry;
+
+        std::string                                             directory_;
+        std::mutex                                              mutex_;
+        std::unordered_map<std::string, std::shared_ptr<entry>> entries_;
+        std::atomic<unsigned>                                   hits_, misses_;
+    };
+} // namespace standardese
+
+#endif // STANDARDESE_PREAMBLE_CACHE_HPP_INCLUDED
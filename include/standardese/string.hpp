@@ -5,7 +5,9 @@
 #ifndef STANDARDESE_STRING_HPP_INCLUDED
 #define STANDARDESE_STRING_HPP_INCLUDED
 
+#include <atomic>
 #include <cstring>
+#include <functional>
 #include <new>
 #include <string>
 #include <type_traits>
@@ -16,7 +18,78 @@
 
 namespace standardese
 {
+    namespace detail
+    {
+        struct interned_node
+        {
+            std::string                 str;
+            std::size_t                 hash;
+            std::atomic<interned_node*> next;
+
+            interned_node(const char* str, std::size_t length, std::size_t hash)
+            : str(str, length), hash(hash), next(nullptr)
+            {
+            }
+        };
+    } // namespace detail
+
+    /// A string stored in a global pool.
+    ///
+    /// Equal strings are only stored once,
+    /// so comparing and hashing interned strings doesn't need to look at the characters.
+    /// The pool can be used from multiple threads, strings in it are never freed.
+    class interned_string
+    {
+    public:
+        /// \effects Looks up the string in the pool, adding it if it isn't there yet.
+        explicit interned_string(const char* str) : interned_string(str, std::strlen(str))
+        {
+        }
+
+        interned_string(const char* str, std::size_t length);
+
+        explicit interned_string(const detail::interned_node& node) STANDARDESE_NOEXCEPT
+        : node_(&node)
+        {
+        }
+
+        const char* c_str() const STANDARDESE_NOEXCEPT
+        {
+            return node_->str.c_str();
+        }
+
+        std::size_t length() const STANDARDESE_NOEXCEPT
+        {
+            return node_->str.length();
+        }
+
+        std::size_t hash() const STANDARDESE_NOEXCEPT
+        {
+            return node_->hash;
+        }
+
+        const detail::interned_node& get_node() const STANDARDESE_NOEXCEPT
+        {
+            return *node_;
+        }
+
+    private:
+        const detail::interned_node* node_;
+    };
+
+    inline bool operator==(const interned_string& a, const interned_string& b) STANDARDESE_NOEXCEPT
+    {
+        return &a.get_node() == &b.get_node();
+    }
+
+    inline bool operator!=(const interned_string& a, const interned_string& b) STANDARDESE_NOEXCEPT
+    {
+        return !(a == b);
+    }
+
     /// Wrapper around CXString used for safe access.
+    ///
+    /// A copy that is part of an entity allocated in an arena stores its characters in it as well.
     class string
     {
     public:
@@ -26,7 +99,10 @@ namespace standardese
 
         string(const char* str, std::size_t n) : length_(n), type_(std_string)
         {
-            ::new (get_storage()) std::string(str, length_);
+            if (auto memory = allocate_in_arena(length_))
+                set_arena(memory, str, length_);
+            else
+                ::new (get_storage()) std::string(str, length_);
         }
 
         template <std::size_t N>
@@ -37,7 +113,16 @@ namespace standardese
 
         string(std::string str) : length_(str.length()), type_(std_string)
         {
-            ::new (get_storage()) std::string(std::move(str));
+            if (auto memory = allocate_in_arena(length_))
+                set_arena(memory, str.c_str(), length_);
+            else
+                ::new (get_storage()) std::string(std::move(str));
+        }
+
+        /// \notes Copies of it don't allocate, they refer to the pool as well.
+        string(interned_string str) STANDARDESE_NOEXCEPT : length_(str.length()), type_(literal)
+        {
+            ::new (get_storage()) const char*(str.c_str());
         }
 
         string(CXString str) STANDARDESE_NOEXCEPT : type_(cx_string)
@@ -56,9 +141,16 @@ namespace standardese
             }
         }
 
-        string(const string& other) : length_(other.length_), type_(std_string)
+        string(const string& other)
+        : length_(other.length_), type_(other.type_ == literal ? literal : std_string)
         {
-            ::new (get_storage()) std::string(other.c_str());
+            if (type_ == literal)
+                // static storage, can be shared
+                ::new (get_storage()) const char*(other.c_str());
+            else if (auto memory = allocate_in_arena(length_))
+                set_arena(memory, other.c_str(), length_);
+            else
+                ::new (get_storage()) std::string(other.c_str());
         }
 
         ~string() STANDARDESE_NOEXCEPT
@@ -68,6 +160,24 @@ namespace standardese
 
         string& operator=(const string& other)
         {
+            if (this == &other)
+                return *this;
+            else if (other.type_ == literal)
+            {
+                auto str = other.c_str();
+                free();
+                ::new (get_storage()) const char*(str);
+                type_   = literal;
+                length_ = other.length_;
+                return *this;
+            }
+            else if (auto memory = allocate_in_arena(other.length_))
+            {
+                free();
+                set_arena(memory, other.c_str(), other.length_);
+                return *this;
+            }
+
             std::string str(other.c_str());
             if (type_ == std_string)
                 *static_cast<std::string*>(get_storage()) = std::move(str);
@@ -75,6 +185,7 @@ namespace standardese
             {
                 free();
                 ::new (get_storage()) std::string(std::move(str));
+                type_ = std_string;
             }
             length_ = other.length_;
 
@@ -85,7 +196,7 @@ namespace standardese
         {
             if (type_ == std_string)
                 return static_cast<const std::string*>(get_storage())->c_str();
-            else if (type_ == literal)
+            else if (type_ == literal || type_ == arena)
                 return *static_cast<const char* const*>(get_storage());
             return clang_getCString(*static_cast<const CXString*>(get_storage()));
         }
@@ -126,8 +237,23 @@ namespace standardese
             return static_cast<const void*>(&storage_);
         }
 
+        // returns memory for length characters and the null terminator
+        // if the string is part of an entity that was just allocated in an arena,
+        // nullptr otherwise
+        char* allocate_in_arena(std::size_t length) const;
+
+        void set_arena(char* memory, const char* str, std::size_t length) STANDARDESE_NOEXCEPT
+        {
+            std::memcpy(memory, str, length);
+            memory[length] = '\0';
+            ::new (get_storage()) const char*(memory);
+            type_   = arena;
+            length_ = length;
+        }
+
         void free() STANDARDESE_NOEXCEPT
         {
+            // memory of an arena is freed together with it
             if (type_ == cx_string)
                 clang_disposeString(*static_cast<CXString*>(get_storage()));
             else if (type_ == std_string)
@@ -142,7 +268,8 @@ namespace standardese
         {
             cx_string,
             std_string,
-            literal,
+            literal, // string with static storage duration, i.e. literal or interned
+            arena,   // string stored in the arena of the entity it is part of
         } type_;
     };
 
@@ -197,6 +324,18 @@ namespace standardese
     }
 } // namespace standardese
 
+namespace std
+{
+    template <>
+    struct hash<standardese::interned_string>
+    {
+        std::size_t operator()(const standardese::interned_string& str) const STANDARDESE_NOEXCEPT
+        {
+            return str.hash();
+        }
+    };
+} // namespace std
+
 namespace Catch
 {
     inline std::string toString(const standardese::string& str)
@@ -5,6 +5,7 @@
 #ifndef STANDARDESE_TEMPLATE_PROCESSOR_HPP_INCLUDED
 #define STANDARDESE_TEMPLATE_PROCESSOR_HPP_INCLUDED
 
+#include <memory>
 #include <string>
 
 #include <standardese/noexcept.hpp>
@@ -99,9 +100,55 @@ namespace standardese
         }
     };
 
+    namespace detail
+    {
+        struct template_program;
+    } // namespace detail
+
+    /// A template file that is parsed once, so that it can be processed multiple times.
+    class compiled_template
+    {
+    public:
+        /// \effects Parses the template using the template configuration of the parser,
+        /// errors are logged but don't stop the parsing.
+        compiled_template(const parser& p, const template_file& input);
+
+        compiled_template(compiled_template&& other) STANDARDESE_NOEXCEPT;
+
+        ~compiled_template() STANDARDESE_NOEXCEPT;
+
+        compiled_template& operator=(compiled_template&& other) STANDARDESE_NOEXCEPT;
+
+        const std::string& get_output_name() const STANDARDESE_NOEXCEPT
+        {
+            return output_name_;
+        }
+
+        const detail::template_program& get_program() const STANDARDESE_NOEXCEPT
+        {
+            return *program_;
+        }
+
+    private:
+        std::string                               output_name_;
+        std::unique_ptr<detail::template_program> program_;
+    };
+
     struct raw_document;
     class output_format_base;
     struct documentation;
+    class output_stream_base;
+
+    /// \effects Processes the template and writes the result directly to `output`.
+    /// Links to entities are written as `standardese://` URLs.
+    void process_template(output_stream_base& output, const parser& p, const index& i,
+                          const compiled_template& templ,
+                          output_format_base*      default_format = nullptr,
+                          const documentation*     doc_file       = nullptr);
+
+    raw_document process_template(const parser& p, const index& i, const compiled_template& templ,
+                                  output_format_base*  default_format = nullptr,
+                                  const documentation* doc_file       = nullptr);
 
     raw_document process_template(const parser& p, const index& i, const template_file& input,
                                   output_format_base*  default_format = nullptr,
@@ -5,11 +5,13 @@
 #ifndef STANDARDESE_TRANSLATION_UNIT_HPP_INCLUDED
 #define STANDARDESE_TRANSLATION_UNIT_HPP_INCLUDED
 
+#include <standardese/detail/memory_arena.hpp>
 #include <standardese/detail/wrapper.hpp>
 #include <standardese/cpp_entity.hpp>
 #include <standardese/cpp_entity_registry.hpp>
 
 #include <iostream>
+#include <memory>
 
 namespace standardese
 {
@@ -28,6 +30,8 @@ namespace standardese
         };
 
         using tu_wrapper = detail::wrapper<CXTranslationUnit, tu_deleter>;
+
+        class token_buffer;
     } // namespace detail
 
     class cpp_file : public cpp_entity, public cpp_entity_container<cpp_entity>
@@ -53,14 +57,22 @@ namespace standardese
             return wrapper_.get();
         }
 
-    private:
-        cpp_file(cpp_name path)
-        : cpp_entity(get_entity_type(), clang_getNullCursor()), path_(std::move(path))
+        // the tokens of the whole file
+        const detail::token_buffer& get_tokens() const STANDARDESE_NOEXCEPT
         {
+            return *tokens_;
         }
 
-        cpp_name           path_;
-        detail::tu_wrapper wrapper_;
+        ~cpp_file() STANDARDESE_NOEXCEPT override;
+
+    private:
+        cpp_file(cpp_name path);
+
+        // owns the memory of all entities parsed from this file
+        detail::memory_arena                  arena_;
+        cpp_name                              path_;
+        detail::tu_wrapper                    wrapper_;
+        std::unique_ptr<detail::token_buffer> tokens_;
 
         friend parser;
     };
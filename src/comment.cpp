@@ -4,8 +4,11 @@
 
 #include <standardese/comment.hpp>
 
+#include <algorithm>
 #include <cmark.h>
+#include <cstring>
 #include <stack>
+#include <thread>
 
 #include <standardese/detail/raw_comment.hpp>
 #include <standardese/detail/wrapper.hpp>
@@ -56,7 +59,9 @@ md_entity_ptr md_comment::do_clone(const md_entity*) const
     return std::move(result);
 }
 
-md_comment::md_comment() : md_container(get_entity_type(), cmark_node_new(CMARK_NODE_CUSTOM_BLOCK))
+md_comment::md_comment()
+: md_container(get_entity_type(),
+               cmark_node_new_with_mem(CMARK_NODE_CUSTOM_BLOCK, detail::get_cmark_mem()))
 {
     auto brief = md_paragraph::make(*this);
     brief->set_section_type(section_type::brief, "");
@@ -64,14 +69,6 @@ md_comment::md_comment() : md_container(get_entity_type(), cmark_node_new(CMARK_
     md_container::add_entity(std::move(brief));
 }
 
-bool detail::comment_compare::operator()(const comment_id& id_a,
-                                         const comment_id& id_b) const STANDARDESE_NOEXCEPT
-{
-    if (id_a.file_name_or_name_ != id_b.file_name_or_name_)
-        return id_a.file_name_or_name_ < id_b.file_name_or_name_;
-    return id_a.line_ < id_b.line_;
-}
-
 bool comment::empty() const STANDARDESE_NOEXCEPT
 {
     assert(!get_content().empty()); // always at least brief
@@ -135,13 +132,6 @@ string detail::get_unique_name(const doc_entity* parent, const string& unique_na
     return result;
 }
 
-bool comment_registry::register_comment(comment_id id, comment c) const
-{
-    std::unique_lock<std::mutex> lock(mutex_);
-    auto result = comments_.insert(std::make_pair(std::move(id), std::move(c)));
-    return result.second;
-}
-
 namespace
 {
     std::pair<string, unsigned> get_location(const cpp_cursor& cur)
@@ -183,12 +173,12 @@ namespace
         if (location.second == 1u)
             // entity is located at the first line of the file
             // only end-of-line comment possible
-            return comment_id(location.first, 1u);
+            return comment_id(location.first.c_str(), 1u);
         else if (name.empty())
-            return comment_id(location.first, location.second - 1);
+            return comment_id(location.first.c_str(), location.second - 1);
 
         auto prefix = t == cpp_entity::base_class_t ? "::" : ".";
-        return comment_id(location.first, location.second - 1,
+        return comment_id(location.first.c_str(), location.second - 1,
                           detail::get_id(std::string(prefix) + name.c_str()));
     }
 
@@ -308,75 +298,292 @@ namespace
         return comment_id(detail::get_id(result.c_str()).c_str());
     }
 
-    template <class Map>
-    const comment* lookup_comment_location(Map& comments, const comment_id& id, const cpp_entity& e,
-                                           const doc_entity* parent)
+    // orders ids of the same file by inline entity name and line
+    bool compare_location(const comment_id& a, const comment_id& b) STANDARDESE_NOEXCEPT
+    {
+        auto a_name = a.is_inline_location() ? a.inline_entity_name().c_str() : "";
+        auto b_name = b.is_inline_location() ? b.inline_entity_name().c_str() : "";
+        if (auto cmp = std::strcmp(a_name, b_name))
+            return cmp < 0;
+        return a.line() < b.line();
+    }
+
+    std::size_t hash_string(const char* str) STANDARDESE_NOEXCEPT
+    {
+        // FNV-1a
+        std::size_t result = 2166136261u;
+        for (; *str; ++str)
+        {
+            result ^= static_cast<unsigned char>(*str);
+            result *= 16777619u;
+        }
+        return result;
+    }
+
+    // appends the node to the list, unless there is already a node equal to it
+    // readers either see the old or the new list
+    template <typename Node, typename Equal>
+    Node* append_unique(std::atomic<Node*>& head, std::unique_ptr<Node> node, Equal equal)
     {
-        auto iter = comments.lower_bound(id);
-        if (iter != comments.end())
+        auto cur = &head;
+        while (true)
         {
-            // first try the next higher one, i.e. end of same line
-            // then try the actual match
-            ++iter;
-            if (iter == comments.end() || !matches(e, iter->first))
+            auto next = cur->load(std::memory_order_acquire);
+            if (!next)
             {
-                --iter;
-                if (!matches(e, iter->first))
-                    return nullptr;
+                if (cur->compare_exchange_strong(next, node.get(), std::memory_order_release,
+                                                 std::memory_order_acquire))
+                    return node.release();
+                // someone else appended, check their node
             }
 
-            if (!iter->second.empty())
-                return &iter->second;
+            if (equal(*next))
+                return next;
+            cur = &next->next;
+        }
+    }
+
+    template <typename Node>
+    void delete_list(std::atomic<Node*>& head) STANDARDESE_NOEXCEPT
+    {
+        auto cur = head.load(std::memory_order_relaxed);
+        while (cur)
+        {
+            auto next = cur->next.load(std::memory_order_relaxed);
+            delete cur;
+            cur = next;
+        }
+    }
+}
+
+const char* detail::intern_file_name(const char* path)
+{
+    auto name = path;
+    for (auto ptr = path; *ptr; ++ptr)
+        if (*ptr == '/' || *ptr == '\\' || *ptr == ':')
+            name = ptr + 1;
+    return interned_string(name).c_str();
+}
 
-            // this command is only used for commands, look for a remote comment
-            auto& comment = iter->second;
+// the comments of a single file sorted by inline entity name and line
+// it is immutable once published, except for the lazily added remote content
+struct comment_registry::file_comments
+{
+    struct entry
+    {
+        enum : unsigned char
+        {
+            unresolved,
+            resolving,
+            resolved
+        };
 
-            iter = comments.find(get_name_id(parent, e, &comment));
-            if (iter != comments.end())
-                // add remote content
-                comment.set_content(iter->second.get_content().clone());
+        comment_id                         id;
+        mutable standardese::comment       comment;
+        bool                               needs_remote;
+        mutable std::atomic<unsigned char> state;
 
-            return &comment;
+        entry(comment_id id, standardese::comment c)
+        : id(std::move(id)), comment(std::move(c)), state(unresolved)
+        {
+            // this comment is only used for commands, content comes from a remote comment
+            needs_remote = comment.empty();
+        }
+
+        entry(entry&& other)
+        : id(std::move(other.id)),
+          comment(std::move(other.comment)),
+          needs_remote(other.needs_remote),
+          state(other.state.load(std::memory_order_relaxed))
+        {
         }
+    };
+
+    const char*                 file_name;
+    std::vector<entry>          entries;
+    std::atomic<file_comments*> next;
+
+    explicit file_comments(const char* file_name) : file_name(file_name), next(nullptr)
+    {
+    }
 
+    const entry* find(const comment_id& id, const cpp_entity& e) const
+    {
+        auto iter = std::lower_bound(entries.begin(), entries.end(), id,
+                                     [](const entry& a, const comment_id& b) {
+                                         return compare_location(a.id, b);
+                                     });
+        if (iter == entries.end())
+            return nullptr;
+
+        // first try the next higher one, i.e. end of same line
+        // then try the actual match
+        auto next = std::next(iter);
+        if (next != entries.end() && matches(e, next->id))
+            return &*next;
+        else if (matches(e, iter->id))
+            return &*iter;
         return nullptr;
     }
+};
+
+struct comment_registry::name_comment
+{
+    std::string                name;
+    standardese::comment       comment;
+    const char*                file_name; // interned, if any
+    std::atomic<name_comment*> next;
+
+    name_comment(std::string name, standardese::comment c, const char* file_name)
+    : name(std::move(name)), comment(std::move(c)), file_name(file_name), next(nullptr)
+    {
+    }
+};
+
+comment_registry::comment_registry() STANDARDESE_NOEXCEPT
+{
+    for (auto& shard : files_)
+        shard.store(nullptr, std::memory_order_relaxed);
+    for (auto& shard : names_)
+        shard.store(nullptr, std::memory_order_relaxed);
 }
 
-const comment* comment_registry::lookup_comment(const cpp_entity& e, const doc_entity* parent) const
+comment_registry::~comment_registry() STANDARDESE_NOEXCEPT
+{
+    for (auto& shard : files_)
+        delete_list(shard);
+    for (auto& shard : names_)
+        delete_list(shard);
+}
+
+void comment_registry::register_comments(comment_list comments, const char* file_name) const
+{
+    using value_type = comment_list::value_type;
+
+    if (file_name)
+        file_name = interned_string(file_name).c_str();
+
+    auto end = std::stable_partition(comments.begin(), comments.end(),
+                                     [](const value_type& c) { return !c.first.is_name(); });
+    for (auto iter = end; iter != comments.end(); ++iter)
+    {
+        auto& name = iter->first.unique_name();
+        std::unique_ptr<name_comment> node(
+            new name_comment(name.c_str(), std::move(iter->second), file_name));
+        append_unique(names_[hash_string(name.c_str()) % no_name_shards], std::move(node),
+                      [&](const name_comment& other) { return other.name == name.c_str(); });
+    }
+
+    std::stable_sort(comments.begin(), end, [](const value_type& a, const value_type& b) {
+        if (a.first.file_name() != b.first.file_name())
+            return std::less<const char*>()(a.first.file_name(), b.first.file_name());
+        return compare_location(a.first, b.first);
+    });
+    for (auto begin = comments.begin(); begin != end;)
+    {
+        std::unique_ptr<file_comments> file(new file_comments(begin->first.file_name()));
+        for (; begin != end && begin->first.file_name() == file->file_name; ++begin)
+        {
+            if (!file->entries.empty() && !compare_location(file->entries.back().id, begin->first))
+                // same id as the previous comment
+                continue;
+            file->entries.emplace_back(std::move(begin->first), std::move(begin->second));
+        }
+
+        append_unique(files_[hash_string(file->file_name) % no_file_shards], std::move(file),
+                      [](const file_comments&) { return false; });
+    }
+}
+
+std::vector<std::pair<std::string, const comment*>> comment_registry::get_name_comments(
+    const char* file_name) const
 {
-    std::unique_lock<std::mutex> lock(mutex_);
+    file_name = interned_string(file_name).c_str();
+
+    std::vector<std::pair<std::string, const comment*>> result;
+    for (auto& shard : names_)
+        for (auto node = shard.load(std::memory_order_acquire); node;
+             node = node->next.load(std::memory_order_acquire))
+            if (node->file_name == file_name)
+                result.emplace_back(node->name, &node->comment);
+    return result;
+}
 
+const comment* comment_registry::lookup_comment(const cpp_entity& e, const doc_entity* parent) const
+{
     // first look for comments at the location
     auto location = create_location_id(e);
-    if (auto c = lookup_comment_location(comments_, location, e, parent))
+    if (location.is_name())
+    {
+        if (auto c = lookup_name(location.unique_name().c_str()))
+            return c;
+    }
+    else if (auto c = lookup_location(location, e, parent))
         return c;
 
     // then for comments with the unique name
-    auto id   = get_name_id(parent, e, nullptr);
-    auto iter = comments_.find(comment_id(id));
-    if (iter != comments_.end())
-        return &iter->second;
+    auto id = get_name_id(parent, e, nullptr);
+    if (auto c = lookup_name(id.unique_name().c_str()))
+        return c;
 
     auto short_id = detail::get_short_id(id.unique_name().c_str());
-    if (id.unique_name() == short_id)
+    if (id.unique_name() == short_id.c_str())
         return nullptr;
-    iter = comments_.find(comment_id(short_id));
-    if (iter != comments_.end())
-        return &iter->second;
-
-    return nullptr;
+    return lookup_name(short_id.c_str());
 }
 
 const comment* comment_registry::lookup_comment(const std::string& module) const
 {
-    std::unique_lock<std::mutex> lock(mutex_);
+    return lookup_name(module.c_str());
+}
 
-    auto id   = comment_id(module);
-    auto iter = comments_.find(id);
-    if (iter != comments_.end())
-        return &iter->second;
+const comment* comment_registry::lookup_location(const comment_id& id, const cpp_entity& e,
+                                                 const doc_entity* parent) const
+{
+    // files with the same name share the ids, so earlier registered ones take precedence
+    const file_comments::entry* entry = nullptr;
+    for (auto file = files_[hash_string(id.file_name()) % no_file_shards].load(
+             std::memory_order_acquire);
+         file && !entry; file = file->next.load(std::memory_order_acquire))
+        if (file->file_name == id.file_name())
+            entry = file->find(id, e);
+
+    if (!entry)
+        return nullptr;
+    else if (!entry->needs_remote)
+        return &entry->comment;
 
+    // look for the remote comment, only one thread adds the content
+    auto state = entry->state.load(std::memory_order_acquire);
+    while (state != file_comments::entry::resolved)
+    {
+        if (state == file_comments::entry::unresolved
+            && entry->state.compare_exchange_weak(state, file_comments::entry::resolving,
+                                                  std::memory_order_acquire))
+        {
+            auto remote =
+                lookup_name(get_name_id(parent, e, &entry->comment).unique_name().c_str());
+            if (remote)
+                entry->comment.set_content(remote->get_content().clone());
+            entry->state.store(remote ? file_comments::entry::resolved :
+                                        file_comments::entry::unresolved,
+                               std::memory_order_release);
+            break;
+        }
+
+        std::this_thread::yield();
+        state = entry->state.load(std::memory_order_acquire);
+    }
+
+    return &entry->comment;
+}
+
+const comment* comment_registry::lookup_name(const char* name) const STANDARDESE_NOEXCEPT
+{
+    for (auto node = names_[hash_string(name) % no_name_shards].load(std::memory_order_acquire);
+         node; node = node->next.load(std::memory_order_acquire))
+        if (node->name == name)
+            return &node->comment;
     return nullptr;
 }
 
@@ -404,7 +611,7 @@ namespace
 
         using md_parser = detail::wrapper<cmark_parser*, parser_deleter>;
 
-        md_parser parser(cmark_parser_new(CMARK_OPT_NORMALIZE));
+        md_parser parser(cmark_parser_new_with_mem(CMARK_OPT_NORMALIZE, detail::get_cmark_mem()));
         cmark_parser_feed(parser.get(), raw_comment.c_str(), raw_comment.length());
         return cmark_parser_finish(parser.get());
     }
@@ -426,19 +633,18 @@ namespace
         }
     };
 
-    void register_comment(const parser& p, comment_info& info)
+    void register_comment(comment_registry::comment_list& comments, comment_info& info)
     {
-        auto& registry = p.get_comment_registry();
         if (info.inline_comment)
-            registry.register_comment(comment_id(info.file_name, info.end_line,
-                                                 detail::get_id(info.entity_name.c_str())),
-                                      std::move(info.comment));
+            comments.emplace_back(comment_id(info.file_name.c_str(), info.end_line,
+                                             detail::get_id(info.entity_name.c_str())),
+                                  std::move(info.comment));
         else if (!info.entity_name.empty())
-            registry.register_comment(comment_id(detail::get_id(info.entity_name.c_str())),
-                                      std::move(info.comment));
+            comments.emplace_back(comment_id(detail::get_id(info.entity_name.c_str())),
+                                  std::move(info.comment));
         else
-            registry.register_comment(comment_id(info.file_name, info.end_line),
-                                      std::move(info.comment));
+            comments.emplace_back(comment_id(info.file_name.c_str(), info.end_line),
+                                  std::move(info.comment));
     }
 
     std::string read_command(const parser& p, const md_entity& e)
@@ -493,7 +699,8 @@ namespace
     class container_stack
     {
     public:
-        explicit container_stack(const parser& p, comment_info& info) : info_(&info), parser_(&p)
+        explicit container_stack(comment_registry::comment_list& comments, comment_info& info)
+        : info_(&info), comments_(&comments)
         {
         }
 
@@ -577,7 +784,7 @@ namespace
         void pop_info()
         {
             if (cur_inline_)
-                register_comment(*parser_, *cur_inline_);
+                register_comment(*comments_, *cur_inline_);
             cur_inline_.reset(nullptr);
         }
 
@@ -612,10 +819,10 @@ namespace
             }
         };
 
-        std::stack<container>         stack_;
-        std::unique_ptr<comment_info> cur_inline_; // that's a lazy optional emulation, right there
-        comment_info*                 info_;
-        const parser*                 parser_;
+        std::stack<container>           stack_;
+        std::unique_ptr<comment_info>   cur_inline_; // that's a lazy optional emulation, right there
+        comment_info*                   info_;
+        comment_registry::comment_list* comments_;
     };
 
     std::size_t get_group_id(const char* name, const char* end)
@@ -746,7 +953,8 @@ namespace
         return false;
     }
 
-    void parse_comment(const parser& p, comment_info& info, const md_node& root)
+    void parse_comment(const parser& p, comment_registry::comment_list& comments,
+                       comment_info& info, const md_node& root)
     {
         struct iter_deleter
         {
@@ -759,7 +967,7 @@ namespace
         using md_iter = detail::wrapper<cmark_iter*, iter_deleter>;
         md_iter iter(cmark_iter_new(root.get()));
 
-        container_stack stack(p, info);
+        container_stack stack(comments, info);
         auto            first_content = true;
         for (auto ev = CMARK_EVENT_NONE; (ev = cmark_iter_next(iter.get())) != CMARK_EVENT_DONE;)
         {
@@ -811,12 +1019,14 @@ namespace
             }
         }
 
-        register_comment(p, info);
+        register_comment(comments, info);
     }
 }
 
 void standardese::parse_comments(const parser& p, const char* file_name, const std::string& source)
 {
+    comment_registry::comment_list comments;
+
     auto raw_comments = detail::read_comments(source);
     for (auto& raw_comment : raw_comments)
     {
@@ -824,6 +1034,8 @@ void standardese::parse_comments(const parser& p, const char* file_name, const s
                           raw_comment.end_line);
 
         auto document = parse_document(p, raw_comment.content);
-        parse_comment(p, info, document);
+        parse_comment(p, comments, info, document);
     }
+
+    p.get_comment_registry().register_comments(std::move(comments), file_name);
 }
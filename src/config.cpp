@@ -6,6 +6,9 @@
 
 #include <clang-c/CXCompilationDatabase.h>
 #include <set>
+#include <unordered_map>
+
+#include <boost/filesystem.hpp>
 #include <spdlog/fmt/fmt.h>
 
 #include <standardese/detail/tokenizer.hpp>
@@ -15,6 +18,8 @@
 
 using namespace standardese;
 
+namespace fs = boost::filesystem;
+
 namespace
 {
     const char* standards[int(cpp_standard::count)];
@@ -59,7 +64,7 @@ namespace
 
     using commands = detail::wrapper<CXCompileCommands, commands_deleter>;
 
-    std::set<std::string> get_db_args(const char* commands_dir)
+    database load_database(const char* commands_dir)
     {
         auto error   = CXCompilationDatabase_NoError;
         auto db_impl = clang_CompilationDatabase_fromDirectory(commands_dir, &error);
@@ -68,51 +73,152 @@ namespace
                                      CXError_InvalidArguments :
                                      CXError_Failure,
                                  std::string("CXCompilationDatabase (") + commands_dir + ")");
+        return database(db_impl);
+    }
+
+    bool is_one_of(const std::string& arg, std::initializer_list<const char*> options)
+    {
+        for (auto option : options)
+            if (arg == option)
+                return true;
+        return false;
+    }
+
+    // options whose value is the next argument
+    bool has_separate_value(const std::string& arg)
+    {
+        return is_one_of(arg, {"-o", "-x", "-I", "-F", "-D", "-U", "-MF", "-MT", "-MQ", "-include",
+                               "-include-pch", "-imacros", "-isystem", "-iquote", "-idirafter",
+                               "-isysroot", "--sysroot", "-iprefix", "-iwithprefix",
+                               "-iwithprefixbefore", "-ivfsoverlay", "-Xclang", "-Xpreprocessor",
+                               "-Xassembler", "-Xlinker", "-target", "-arch", "--param"});
+    }
+
+    // options whose value is a path relative to the directory of the command
+    bool has_path_value(const std::string& arg)
+    {
+        return is_one_of(arg, {"-I", "-F", "-include", "-include-pch", "-imacros", "-isystem",
+                               "-iquote", "-idirafter", "-isysroot", "--sysroot", "-iprefix",
+                               "-ivfsoverlay"});
+    }
+
+    // options that don't affect parsing or conflict with the ones used by standardese
+    bool is_ignored(const std::string& arg)
+    {
+        return is_one_of(arg, {"-c", "-o", "-x", "-M", "-MM", "-MD", "-MMD", "-MF", "-MT", "-MQ",
+                               "-MP", "-Xassembler", "-Xlinker"});
+    }
 
-        database              db(db_impl);
-        std::set<std::string> db_args;
+    std::string get_absolute_path(const std::string& path, const fs::path& dir)
+    {
+        return fs::absolute(path, dir).normalize().generic_string();
+    }
+
+    std::size_t get_common_prefix_length(const fs::path& a, const fs::path& b)
+    {
+        auto result = 0u;
+        for (auto iter_a = a.begin(), iter_b = b.begin();
+             iter_a != a.end() && iter_b != b.end() && *iter_a == *iter_b; ++iter_a, ++iter_b)
+            ++result;
+        return result;
+    }
+}
+
+// the commands of a compilation database
+// identical flags of multiple commands are only stored once
+class detail::compile_commands
+{
+public:
+    explicit compile_commands(const char* commands_dir)
+    {
+        auto db = load_database(commands_dir);
 
         commands cmds(clang_CompilationDatabase_getAllCompileCommands(db.get()));
         auto     num = clang_CompileCommands_getSize(cmds.get());
         for (auto i = 0u; i != num; ++i)
+            add_command(clang_CompileCommands_getCommand(cmds.get(), i));
+    }
+
+    // returns the flags of the command that compiles the given file
+    // if there is none, as is usually the case for headers,
+    // uses the command of the file in the nearest directory, preferring one with the same stem
+    const std::vector<string>& get_flags(const char* full_path) const
+    {
+        static const std::vector<string> no_flags;
+
+        auto path = fs::system_complete(full_path).normalize();
+        auto iter = files_.find(path.generic_string());
+        if (iter != files_.end())
+            return *iter->second;
+
+        const command* nearest    = nullptr;
+        std::size_t    best_score = 0u;
+        for (auto& cmd : commands_)
         {
-            auto cmd     = clang_CompileCommands_getCommand(cmds.get(), i);
-            auto no_args = clang_CompileCommand_getNumArgs(cmd);
+            auto score = 2u * get_common_prefix_length(path.parent_path(), cmd.dir)
+                         + (path.stem() == cmd.stem ? 1u : 0u);
+            if (!nearest || score > best_score)
+            {
+                nearest    = &cmd;
+                best_score = score;
+            }
+        }
+
+        return nearest ? *nearest->flags : no_flags;
+    }
+
+private:
+    struct command
+    {
+        fs::path                   dir, stem;
+        const std::vector<string>* flags;
+    };
+
+    void add_command(CXCompileCommand cmd)
+    {
+        fs::path dir(string(clang_CompileCommand_getDirectory(cmd)).c_str());
+        auto file = get_absolute_path(string(clang_CompileCommand_getFilename(cmd)).c_str(), dir);
 
-            auto        was_ignored = false;
-            std::string cur;
-            for (auto j = 1u; j != no_args; ++j)
+        std::vector<string> flags;
+
+        auto no_args = clang_CompileCommand_getNumArgs(cmd);
+        // first argument is the compiler
+        for (auto i = 1u; i < no_args; ++i)
+        {
+            std::string arg = string(clang_CompileCommand_getArg(cmd, i)).c_str();
+            if (arg.empty() || arg[0] != '-')
+            {
+                // either the input file or the value of an option not known here
+                if (get_absolute_path(arg, dir) != file)
+                    flags.push_back(arg);
+            }
+            else if (is_ignored(arg))
+                i += has_separate_value(arg) ? 1u : 0u;
+            else if (has_separate_value(arg) && i + 1u < no_args)
             {
-                string str(clang_CompileCommand_getArg(cmd, j));
-
-                // skip -c arg and -o arg
-                if (str == "-c" || str == "-o")
-                    was_ignored = true;
-                else if (was_ignored)
-                    was_ignored = false;
-                else if (*str.c_str() == '-')
-                {
-                    // we have an option
-                    // store it to later append with parameter
-                    // but if there is no option, it will be non-empty on the next option
-                    if (!cur.empty())
-                    {
-                        db_args.insert(std::move(cur));
-                        cur.clear();
-                    }
-                    cur += str.c_str();
-                }
-                else
-                {
-                    db_args.insert(cur + str.c_str());
-                    cur.clear();
-                }
+                std::string value = string(clang_CompileCommand_getArg(cmd, ++i)).c_str();
+                flags.push_back(arg);
+                flags.push_back(has_path_value(arg) ? get_absolute_path(value, dir) : value);
             }
+            else if (arg.size() > 2u && arg.compare(0, 2, "-I") == 0)
+                flags.push_back("-I" + get_absolute_path(arg.substr(2), dir));
+            else
+                flags.push_back(arg);
         }
 
-        return db_args;
+        fs::path path(file);
+        auto     shared = &*flags_.insert(std::move(flags)).first;
+        commands_.push_back({path.parent_path(), path.stem(), shared});
+        files_.emplace(std::move(file), shared);
     }
 
+    std::set<std::vector<string>>                               flags_;
+    std::unordered_map<std::string, const std::vector<string>*> files_;
+    std::vector<command>                                        commands_;
+};
+
+namespace
+{
     // cmake sucks at string handling, so sometimes LIBCLANG_SYSTEM_INCLUDE_DIR isn't a string
     // so we need to stringify it
     // but if the argument was a string, libclang can't handle the double quotes
@@ -140,18 +246,15 @@ namespace
 
 compile_config::compile_config(cpp_standard standard, string commands_dir)
 : flags_{"-x", "c++", "-I", unquote(STANDARDESE_DETAIL_STRINGIFY(LIBCLANG_SYSTEM_INCLUDE_DIR))},
-  clang_binary_(get_clang_binary_default())
+  commands_pos_(flags_.size()),
+  clang_binary_(get_clang_binary_default()),
+  external_preprocessor_(false),
+  parse_function_bodies_(false)
 {
     (void)standards_initializer;
 
     if (!commands_dir.empty())
-    {
-        auto db_args = get_db_args(commands_dir.c_str());
-
-        flags_.reserve(flags_.size() + db_args.size());
-        for (auto& arg : db_args)
-            flags_.push_back(arg);
-    }
+        commands_ = std::make_shared<const detail::compile_commands>(commands_dir.c_str());
 
     if (standard != cpp_standard::count)
         flags_.push_back(standards[int(standard)]);
@@ -188,13 +291,23 @@ void compile_config::set_msvc_compatibility_version(unsigned version)
         flags_.push_back(fmt::format("-fms-compatibility-version={}", version));
 }
 
-std::vector<const char*> compile_config::get_flags() const
+std::vector<const char*> compile_config::get_flags(const char* full_path) const
 {
-    std::vector<const char*> result;
-    result.reserve(flags_.size());
+    static const std::vector<string> no_flags;
+    auto& commands_flags = commands_ ? commands_->get_flags(full_path) : no_flags;
 
-    for (auto& flag : flags_)
+    std::vector<const char*> result;
+    result.reserve(flags_.size() + commands_flags.size());
+
+    // flags of the compilation database come before all others,
+    // so that they can be overridden
+    auto insert_pos = flags_.begin() + std::ptrdiff_t(commands_pos_);
+    for (auto iter = flags_.begin(); iter != insert_pos; ++iter)
+        result.push_back(iter->c_str());
+    for (auto& flag : commands_flags)
         result.push_back(flag.c_str());
+    for (auto iter = insert_pos; iter != flags_.end(); ++iter)
+        result.push_back(iter->c_str());
 
     return result;
 }
@@ -4,6 +4,7 @@
 
 #include <standardese/cpp_entity.hpp>
 
+#include <standardese/detail/memory_arena.hpp>
 #include <standardese/detail/parse_utils.hpp>
 #include <standardese/detail/tokenizer.hpp>
 #include <standardese/cpp_class.hpp>
@@ -16,6 +17,9 @@
 #include <standardese/error.hpp>
 #include <standardese/translation_unit.hpp>
 
+#include <cstddef>
+#include <new>
+
 #include <spdlog/fmt/fmt.h>
 
 using namespace standardese;
@@ -126,6 +130,31 @@ cpp_entity_ptr cpp_entity::try_parse(translation_unit& tu, cpp_cursor cur, const
                       fmt::format("Unknown cursor kind '{}'", spelling.c_str()), severity::warning);
 }
 
+void* cpp_entity::operator new(std::size_t size)
+{
+    // no header needed to remember where the memory came from,
+    // the constructor stores it in the entity
+    auto arena = detail::memory_arena::get_current(detail::arena_kind::cpp_entity);
+    return arena ? arena->allocate(size, alignof(std::max_align_t)) : ::operator new(size);
+}
+
+void cpp_entity::operator delete(void* ptr) STANDARDESE_NOEXCEPT
+{
+    // the arena is still the one the memory was allocated from
+    if (!detail::memory_arena::get_current(detail::arena_kind::cpp_entity))
+        ::operator delete(ptr);
+}
+
+void detail::cpp_entity_deleter::operator()(cpp_entity* entity) const STANDARDESE_NOEXCEPT
+{
+    auto memory   = dynamic_cast<void*>(entity);
+    auto in_arena = entity->in_arena_;
+    entity->~cpp_entity();
+    // memory of an arena is freed together with the file
+    if (!in_arena)
+        ::operator delete(memory);
+}
+
 cpp_name cpp_entity::get_name() const
 {
     return detail::parse_name(cursor_);
@@ -154,9 +183,17 @@ cpp_name cpp_entity::get_scope() const
 
 cpp_name cpp_entity::get_unique_name(bool exclude_scope) const
 {
-    if (exclude_scope)
-        return do_get_unique_name();
-    return get_scope_impl(*this, true) + do_get_unique_name().c_str();
+    auto& cache = exclude_scope ? unique_name_ : scoped_unique_name_;
+    if (auto node = cache.load(std::memory_order_acquire))
+        return interned_string(*node);
+
+    // multiple threads might compute it at the same time,
+    // but they'll all store the same node
+    auto name   = exclude_scope ? do_get_unique_name() :
+                                get_scope_impl(*this, true) + get_unique_name(true).c_str();
+    auto result = interned_string(name.c_str(), name.length());
+    cache.store(&result.get_node(), std::memory_order_release);
+    return result;
 }
 
 cpp_name cpp_entity::do_get_unique_name() const
@@ -170,11 +207,23 @@ cpp_name cpp_entity::do_get_unique_name() const
 }
 
 cpp_entity::cpp_entity(type t, cpp_cursor cur, const cpp_entity& parent)
-: cursor_(cur), next_(nullptr), parent_(&parent), t_(t)
+: cursor_(cur),
+  next_(nullptr),
+  parent_(&parent),
+  t_(t),
+  in_arena_(detail::memory_arena::get_current(detail::arena_kind::cpp_entity) != nullptr),
+  unique_name_(nullptr),
+  scoped_unique_name_(nullptr)
 {
 }
 
 cpp_entity::cpp_entity(type t, cpp_cursor cur)
-: cursor_(cur), next_(nullptr), parent_(nullptr), t_(t)
+: cursor_(cur),
+  next_(nullptr),
+  parent_(nullptr),
+  t_(t),
+  in_arena_(detail::memory_arena::get_current(detail::arena_kind::cpp_entity) != nullptr),
+  unique_name_(nullptr),
+  scoped_unique_name_(nullptr)
 {
 }
\ No newline at end of file
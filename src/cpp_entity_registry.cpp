@@ -0,0 +1,91 @@
+// Copyright (C) 2016 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <standardese/cpp_entity_registry.hpp>
+
+#include <functional>
+#include <stdexcept>
+
+using namespace standardese;
+
+// the entities of a single translation unit
+// it is immutable once published
+struct cpp_entity_registry::tu_entities
+{
+    CXTranslationUnit tu;
+    entity_map        entities;
+    tu_entities*      next;
+
+    tu_entities(CXTranslationUnit tu, entity_map entities)
+    : tu(tu), entities(std::move(entities)), next(nullptr)
+    {
+    }
+};
+
+namespace
+{
+    std::size_t get_shard(CXTranslationUnit tu, std::size_t no_shards) STANDARDESE_NOEXCEPT
+    {
+        return std::hash<CXTranslationUnit>()(tu) % no_shards;
+    }
+}
+
+cpp_entity_registry::cpp_entity_registry() STANDARDESE_NOEXCEPT
+{
+    for (auto& shard : shards_)
+        shard.store(nullptr, std::memory_order_relaxed);
+}
+
+cpp_entity_registry::~cpp_entity_registry() STANDARDESE_NOEXCEPT
+{
+    for (auto& shard : shards_)
+    {
+        auto cur = shard.load(std::memory_order_relaxed);
+        while (cur)
+        {
+            auto next = cur->next;
+            delete cur;
+            cur = next;
+        }
+    }
+}
+
+void cpp_entity_registry::register_entities(CXTranslationUnit tu, entity_map entities) const
+{
+    auto node = new tu_entities(tu, std::move(entities));
+
+    // push front, readers either see the old or the new list
+    auto& shard = shards_[get_shard(tu, no_shards)];
+    node->next  = shard.load(std::memory_order_relaxed);
+    while (!shard.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                        std::memory_order_relaxed))
+        ;
+}
+
+const cpp_entity& cpp_entity_registry::lookup_entity(const cpp_cursor& cur) const
+{
+    auto entity = try_lookup(cur);
+    if (!entity)
+        throw std::out_of_range("entity not registered");
+    return *entity;
+}
+
+const cpp_entity* cpp_entity_registry::try_lookup(const cpp_cursor& cur) const
+    STANDARDESE_NOEXCEPT
+{
+    // cursors of different translation units are never equal,
+    // so only the entities of the cursor's translation unit need to be searched
+    auto tu = clang_Cursor_getTranslationUnit(cur);
+    for (auto node = shards_[get_shard(tu, no_shards)].load(std::memory_order_acquire); node;
+         node      = node->next)
+    {
+        if (node->tu != tu)
+            continue;
+
+        auto iter = node->entities.find(cur);
+        return iter == node->entities.end() ? nullptr : iter->second;
+    }
+
+    return nullptr;
+}
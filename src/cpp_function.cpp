@@ -245,7 +245,7 @@ namespace
                 continue;
             else if (detail::skip_if_token(stream, "static"))
                 minfo.virtual_flag = cpp_virtual_static;
-            else if (detail::skip_if_token(stream, "__standardese_friend"))
+            else if (detail::skip_if_token(stream, "__frnd"))
                 minfo.virtual_flag = cpp_virtual_friend;
             else if (detail::skip_if_token(stream, "constexpr"))
                 finfo.set_flag(cpp_constexpr_fnc);
@@ -265,7 +265,7 @@ namespace
                     while (std::isspace(*ptr))
                         ++ptr;
 
-                    auto spelling = stream.peek().get_value();
+                    auto& spelling = stream.peek().get_value();
                     if (!std::isspace(spelling[0]))
                     {
                         auto res = std::strncmp(ptr, spelling.c_str(), spelling.length());
@@ -280,7 +280,7 @@ namespace
             }
             else
             {
-                auto spelling = stream.get().get_value();
+                auto& spelling = stream.get().get_value();
                 if (spelling == "decltype")
                     allow_auto = true; // decltype return, allow auto in return type
                 else if (spelling == "::")
@@ -306,7 +306,7 @@ namespace
             auto was_opening_paren = false;
             for (auto paren_count = 0u; stream.get_iter() != save; stream.bump_back())
             {
-                auto str = stream.peek().get_value();
+                auto& str = stream.peek().get_value();
 
                 if (paren_count == unsigned(returns_function) && was_opening_paren && str == ">")
                 {
@@ -366,7 +366,7 @@ namespace
             auto bracket_count = 1;
             while (bracket_count != 0)
             {
-                auto spelling = stream.get().get_value();
+                auto& spelling = stream.get().get_value();
                 if (spelling == "(")
                     ++bracket_count;
                 else if (spelling == ")")
@@ -412,7 +412,7 @@ namespace
 
     cpp_function_definition parse_special_definition(detail::token_stream& stream, cpp_cursor cur)
     {
-        auto spelling = stream.get().get_value();
+        auto& spelling = stream.get().get_value();
 
         if (spelling == "default")
             // defaulted function
@@ -476,7 +476,7 @@ namespace
                 // trailing return type
                 while (!is_declaration_end(stream, cur, special_definition))
                 {
-                    auto spelling = stream.get().get_value();
+                    auto& spelling = stream.get().get_value();
                     detail::append_token(trailing_return_type, spelling);
                     if (spelling == "decltype")
                     {
@@ -507,7 +507,7 @@ namespace
             }
             else if (!std::isspace(stream.peek().get_value()[0]))
             {
-                auto str = stream.get().get_value();
+                auto& str = stream.get().get_value();
                 throw parse_error(source_location(cur),
                                   "unexpected token \'" + std::string(str.c_str()) + "\'");
             }
@@ -752,7 +752,7 @@ cpp_ptr<cpp_conversion_op> cpp_conversion_op::parse(translation_unit& tu, cpp_cu
             minfo.virtual_flag = cpp_virtual_new;
         else if (!std::isspace(stream.peek().get_value()[0]))
         {
-            auto str = stream.get().get_value();
+            auto& str = stream.get().get_value();
             throw parse_error(source_location(cur),
                               "unexpected token \'" + std::string(str.c_str()) + "\'");
         }
@@ -837,7 +837,7 @@ cpp_ptr<cpp_constructor> cpp_constructor::parse(translation_unit& tu, cpp_cursor
             info.set_flag(cpp_constexpr_fnc);
         else if (!std::isspace(stream.peek().get_value()[0]))
         {
-            auto str = stream.get().get_value();
+            auto& str = stream.get().get_value();
             throw parse_error(source_location(cur),
                               "unexpected token \'" + std::string(str.c_str()) + "\'");
         }
@@ -869,7 +869,7 @@ cpp_ptr<cpp_constructor> cpp_constructor::parse(translation_unit& tu, cpp_cursor
         }
         else if (!std::isspace(stream.peek().get_value()[0]))
         {
-            auto str = stream.get().get_value();
+            auto& str = stream.get().get_value();
             throw parse_error(source_location(cur),
                               "unexpected token \'" + std::string(str.c_str()) + "\'");
         }
@@ -992,7 +992,7 @@ cpp_ptr<cpp_destructor> cpp_destructor::parse(translation_unit& tu, cpp_cursor c
         }
         else if (!std::isspace(stream.peek().get_value()[0]))
         {
-            auto str = stream.get().get_value();
+            auto& str = stream.get().get_value();
             throw parse_error(source_location(cur),
                               "unexpected token \'" + std::string(str.c_str()) + "\'");
         }
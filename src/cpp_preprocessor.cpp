@@ -4,6 +4,14 @@
 
 #include <standardese/cpp_preprocessor.hpp>
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
 #include <boost/config.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/version.hpp>
@@ -16,6 +24,7 @@
 #warning "Boost less than 1.55 isn't tested"
 #endif
 
+#include <standardese/detail/parse_utils.hpp>
 #include <standardese/detail/tokenizer.hpp>
 #include <standardese/config.hpp>
 #include <standardese/error.hpp>
@@ -109,13 +118,14 @@ namespace
     std::string get_command(const compile_config& c, const char* full_path)
     {
         // -E: print preprocessor output
-        // -C: keep comments
+        // -CC: keep comments, even in macros
+        // -dD: keep macro definitions
         // -Wno-pragma-once-outside-header: hide wrong warning
         std::string cmd(fs::path(c.get_clang_binary()).generic_string()
-                        + " -E -CC -Wno-pragma-once-outside-header ");
-        for (auto& flag : c)
+                        + " -E -CC -dD -Wno-pragma-once-outside-header ");
+        for (auto flag : c.get_flags(full_path))
         {
-            cmd += '"' + std::string(flag.c_str()) + '"';
+            cmd += '"' + std::string(flag) + '"';
             cmd += ' ';
         }
 
@@ -123,19 +133,13 @@ namespace
         return cmd;
     }
 
-    std::string get_full_preprocess_output(const parser& p, const compile_config& c,
-                                           const char* full_path)
+    // runs the preprocessor and passes its output to the consumer in chunks
+    template <typename Consumer>
+    void run_external_preprocessor(const parser& p, const compile_config& c,
+                                   const char* full_path, Consumer consume)
     {
-        std::string preprocessed;
-
         auto    cmd = get_command(c, full_path);
-        Process process(cmd, "",
-                        [&](const char* str, std::size_t n) {
-                            preprocessed.reserve(preprocessed.size() + n);
-                            for (auto end = str + n; str != end; ++str)
-                                if (*str != '\r')
-                                    preprocessed.push_back(*str);
-                        },
+        Process process(cmd, "", [&](const char* str, std::size_t n) { consume(str, n); },
                         [&](const char* str, std::size_t n) {
                             p.get_logger()->error("[preprocessor] {}", std::string(str, n));
                         });
@@ -143,8 +147,6 @@ namespace
         auto exit_code = process.get_exit_status();
         if (exit_code != 0)
             throw process_error(cmd, exit_code);
-
-        return preprocessed;
     }
 
     struct line_marker
@@ -156,13 +158,26 @@ namespace
             system    = 4, // flag 3
         };
 
-        std::string file_name;
+        // points into the preprocessor output
+        const char* file_name;
+        std::size_t file_name_length;
         unsigned    line, flags;
 
-        line_marker() : line(0u), flags(0u)
+        line_marker() : file_name(""), file_name_length(0u), line(0u), flags(0u)
         {
         }
 
+        std::string get_file_name() const
+        {
+            return std::string(file_name, file_name_length);
+        }
+
+        bool is_file(const char* name) const
+        {
+            return std::strncmp(file_name, name, file_name_length) == 0
+                   && name[file_name_length] == '\0';
+        }
+
         void set_flag(flag_t f)
         {
             flags |= f;
@@ -179,47 +194,47 @@ namespace
         }
     };
 
+    bool is_line_marker(const char* begin, const char* end)
+    {
+        auto size = end - begin;
+        return size > 0 && begin[0] == '#' && (size < 2 || begin[1] == ' ')
+               && (size < 3 || std::isdigit(begin[2]));
+    }
+
     // preprocessor line marker
     // format: # <line> "<file-name>" <flags>
     // flag 1 - start of a new file
     // flag 2 - returning to previous file
     // flag 3 - system header
     // flag 4 is irrelevant
-    line_marker parse_line_marker(const char*& ptr)
+    line_marker parse_line_marker(const char* begin, const char* end)
     {
         line_marker result;
 
+        auto ptr = begin;
         assert(*ptr == '#');
         ++ptr;
 
-        while (*ptr == ' ')
+        while (ptr != end && *ptr == ' ')
             ++ptr;
 
-        std::string line;
-        while (std::isdigit(*ptr))
-            line += *ptr++;
-        result.line = unsigned(std::stoi(line));
+        while (ptr != end && std::isdigit(*ptr))
+            result.line = result.line * 10u + unsigned(*ptr++ - '0');
 
-        while (*ptr == ' ')
+        while (ptr != end && *ptr == ' ')
             ++ptr;
 
-        assert(*ptr == '"');
+        assert(ptr != end && *ptr == '"');
         ++ptr;
 
-        std::string file_name;
-        while (*ptr != '"')
-            file_name += *ptr++;
-        ++ptr;
-        result.file_name = std::move(file_name);
+        auto name_end = static_cast<const char*>(std::memchr(ptr, '"', std::size_t(end - ptr)));
+        assert(name_end);
+        result.file_name        = ptr;
+        result.file_name_length = std::size_t(name_end - ptr);
+        ptr                     = name_end + 1;
 
-        while (*ptr == ' ')
-            ++ptr;
-
-        while (*ptr != '\n')
+        for (; ptr != end; ++ptr)
         {
-            if (*ptr == ' ')
-                ++ptr;
-
             switch (*ptr)
             {
             case '1':
@@ -232,157 +247,1190 @@ namespace
                 result.set_flag(line_marker::system);
                 break;
             case '4':
+            case ' ':
+            case '\r':
+            case '\n':
                 break;
             default:
                 assert(false);
             }
-            ++ptr;
         }
 
         return result;
     }
 
-    CXTranslationUnit get_cxunit(CXIndex index, const compile_config& c, const char* full_path)
+    CXTranslationUnit get_cxunit(CXIndex index, const compile_config& c, const char* full_path,
+                                 unsigned options)
     {
-        auto args = c.get_flags();
+        auto args = c.get_flags(full_path);
 
         CXTranslationUnit tu;
         auto              error =
             clang_parseTranslationUnit2(index, full_path, args.data(),
-                                        static_cast<int>(args.size()), nullptr, 0,
-                                        CXTranslationUnit_Incomplete
-                                            | CXTranslationUnit_DetailedPreprocessingRecord,
-                                        &tu);
+                                        static_cast<int>(args.size()), nullptr, 0, options, &tu);
         if (error != CXError_Success)
             throw libclang_error(error, "CXTranslationUnit (" + std::string(full_path) + ")");
         return tu;
     }
 
-    void add_macros(const parser& p, const compile_config& c, const char* full_path, cpp_file& file,
-                    const std::vector<unsigned>& fake_lines)
+    unsigned get_fake_line(const std::vector<unsigned>& fake_lines, unsigned line)
+    {
+        auto iter = std::lower_bound(fake_lines.begin(), fake_lines.end(), line);
+        return unsigned(iter - fake_lines.begin()) + line;
+    }
+
+    // filters the output of the preprocessor while it arrives,
+    // only the main file is kept and the includes are replaced by include directives
+    // the text of included files is skipped line by line and never copied
+    class line_marker_filter
     {
-        detail::tu_wrapper tu(get_cxunit(p.get_cxindex(), c, full_path));
-        auto               cxfile = clang_getFile(tu.get(), full_path);
-        auto               iter   = fake_lines.begin();
+    public:
+        line_marker_filter(const preprocessor& pp, const char* full_path, cpp_file& file)
+        : pp_(pp),
+          file_(file),
+          full_path_(full_path),
+          line_no_(1u),
+          fake_lines_(0u),
+          file_depth_(0),
+          in_c_comment_(false),
+          skip_line_(false)
+        {
+        }
 
-        detail::visit_tu(tu.get(), cxfile, [&](cpp_cursor cur, cpp_cursor) {
-            if (clang_getCursorKind(cur) == CXCursor_MacroDefinition)
+        void consume(const char* str, std::size_t n)
+        {
+            auto end = str + n;
+            if (skip_line_ || !partial_.empty())
             {
-                auto     loc = clang_getCursorLocation(cur);
-                unsigned line;
-                clang_getSpellingLocation(loc, nullptr, &line, nullptr, nullptr);
+                // finish the line started in the previous chunk
+                auto newl = static_cast<const char*>(std::memchr(str, '\n', n));
+                if (!newl)
+                {
+                    append_partial(str, end);
+                    return;
+                }
+                else if (skip_line_)
+                    skip_line_ = false;
+                else
+                {
+                    partial_.append(str, newl + 1);
+                    process_line(partial_.data(), partial_.data() + partial_.size());
+                    partial_.clear();
+                }
+                str = newl + 1;
+            }
 
-                iter = std::lower_bound(iter, fake_lines.end(), line);
-                file.add_entity(cpp_macro_definition::parse(tu.get(), cxfile, cur, file,
-                                                            (iter - fake_lines.begin()) + line));
+            while (str != end)
+            {
+                auto newl =
+                    static_cast<const char*>(std::memchr(str, '\n', std::size_t(end - str)));
+                if (!newl)
+                {
+                    append_partial(str, end);
+                    break;
+                }
+
+                process_line(str, newl + 1);
+                str = newl + 1;
             }
-            return CXChildVisit_Continue;
+        }
+
+        std::string finish()
+        {
+            if (!partial_.empty())
+                process_line(partial_.data(), partial_.data() + partial_.size());
+            partial_.clear();
+            skip_line_ = false;
+            return std::move(preprocessed_);
+        }
+
+    private:
+        void append_partial(const char* begin, const char* end)
+        {
+            if (skip_line_)
+                return;
+
+            partial_.append(begin, end);
+            if (file_depth_ > 0
+                && !is_line_marker(partial_.data(), partial_.data() + partial_.size()))
+            {
+                // rest of the line isn't needed
+                partial_.clear();
+                skip_line_ = true;
+            }
+        }
+
+        // [begin, end) is a single line including the newline,
+        // except for the last line of the output
+        void process_line(const char* begin, const char* end)
+        {
+            if (!in_c_comment_ && end - begin >= 3 && is_line_marker(begin, end))
+                process_line_marker(parse_line_marker(begin, end), end[-1] == '\n');
+            else if (file_depth_ == 0)
+                write_line(begin, end);
+        }
+
+        void process_line_marker(const line_marker& marker, bool has_newline)
+        {
+            if (marker.is_file(full_path_))
+            {
+                assert(file_depth_ <= 1);
+                file_depth_ = 0;
+
+                if (marker.none_set())
+                {
+                    if (line_no_ < marker.line)
+                        preprocessed_.append(marker.line - line_no_, '\n');
+                    line_no_ = marker.line;
+                }
+                return;
+            }
+            else if (marker.is_set(line_marker::enter_new))
+            {
+                ++file_depth_;
+                if (file_depth_ == 1 && !marker.is_file("<built-in>")
+                    && !marker.is_file("<command line>"))
+                    write_include(marker);
+            }
+            else if (marker.is_set(line_marker::enter_old))
+                --file_depth_;
+
+            if (file_depth_ == 0 && has_newline)
+            {
+                preprocessed_ += '\n';
+                ++line_no_;
+            }
+        }
+
+        void write_include(const line_marker& marker)
+        {
+            // line of the include in the preprocessed output
+            auto line = line_no_ + unsigned(fake_lines_);
+
+            auto system = marker.is_set(line_marker::system);
+            preprocessed_ += "#include ";
+            preprocessed_ += system ? '<' : '"';
+            preprocessed_.append(marker.file_name, marker.file_name_length);
+            preprocessed_ += system ? '>' : '"';
+            preprocessed_ += '\n';
+            ++line_no_;
+
+            // also add include
+            auto file_name = marker.get_file_name();
+            if (pp_.is_whitelisted_directory(file_name))
+                file_.add_entity(
+                    cpp_inclusion_directive::make(file_, file_name,
+                                                  system ? cpp_inclusion_directive::system :
+                                                           cpp_inclusion_directive::local,
+                                                  line));
+        }
+
+        void write_line(const char* begin, const char* end)
+        {
+            for (auto ptr = begin; ptr != end; ++ptr)
+            {
+                if (*ptr == '\r')
+                    continue;
+                else if (in_c_comment_ && ptr[0] == '*' && ptr + 1 != end && ptr[1] == '/')
+                {
+                    in_c_comment_ = false;
+                    // add an additional newline
+                    // this allows using c style doc comments in macros
+                    // normally macros would all be one line, so each entity gets the same comment
+                    preprocessed_ += '\n';
+                    ++fake_lines_;
+                }
+                else if (ptr[0] == '/' && ptr + 1 != end && ptr[1] == '*')
+                    in_c_comment_ = true;
+
+                preprocessed_ += *ptr;
+                if (*ptr == '\n')
+                    ++line_no_;
+            }
+        }
+
+        const preprocessor& pp_;
+        cpp_file&           file_;
+        const char*         full_path_;
+
+        std::string preprocessed_, partial_;
+        unsigned    line_no_, fake_lines_;
+        int         file_depth_;
+        bool        in_c_comment_, skip_line_;
+    };
+
+    std::string preprocess_external(const preprocessor& pp, const parser& p,
+                                    const compile_config& c, const char* full_path,
+                                    cpp_file& file)
+    {
+        line_marker_filter filter(pp, full_path, file);
+        run_external_preprocessor(p, c, full_path, [&](const char* str, std::size_t n) {
+            filter.consume(str, n);
         });
+        return filter.finish();
     }
-}
 
-std::string preprocessor::preprocess(const parser& p, const compile_config& c,
-                                     const char* full_path, cpp_file& file) const
-{
-    std::string           preprocessed;
-    std::vector<unsigned> fake_lines;
+    //=== in-process preprocessing ===//
+    // libclang does not expose the preprocessed token stream,
+    // so the main file is rewritten using the preprocessing record of a translation unit:
+    // macro expansions are replaced by their expansion and skipped blocks are removed.
+    // If the translation unit is the one reparsed with the result, all directives are kept,
+    // otherwise inclusion directives are normalized, macro definitions are kept
+    // and all other directives are removed.
+    // Newlines are preserved, so the line numbers are the same as in the original file.
+
+    unsigned get_preprocessing_options()
+    {
+        // function bodies are still lexed and preprocessed when skipped
+        return CXTranslationUnit_Incomplete | CXTranslationUnit_DetailedPreprocessingRecord
+               | CXTranslationUnit_SkipFunctionBodies
+#if CINDEX_VERSION_MINOR >= 34
+               | CXTranslationUnit_KeepGoing
+#endif
+            ;
+    }
+
+    bool read_source(const char* full_path, std::string& source)
+    {
+        std::ifstream file(full_path, std::ios::binary);
+        if (!file.is_open())
+            return false;
+        source.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    // calls f(begin, end, line, keyword) for every preprocessor directive
+    // end is the offset of the terminating newline
+    template <typename Func>
+    void for_each_directive(const std::string& source, Func f)
+    {
+        auto begin      = source.c_str();
+        auto line_no    = 1u;
+        auto in_comment = false;
+        for (auto ptr = begin; *ptr;)
+        {
+            // ptr is at the beginning of a line
+            auto line = ptr;
+            while (*ptr == ' ' || *ptr == '\t')
+                ++ptr;
+
+            if (!in_comment && *ptr == '#')
+            {
+                auto directive_line = line_no;
+
+                ++ptr;
+                while (*ptr == ' ' || *ptr == '\t')
+                    ++ptr;
+                std::string keyword;
+                while (std::isalpha(static_cast<unsigned char>(*ptr)) || *ptr == '_')
+                    keyword += *ptr++;
+
+                // directive ends at the first newline that isn't escaped
+                for (; *ptr; ++ptr)
+                    if (*ptr != '\n')
+                        continue;
+                    else if (ptr[-1] == '\\' || (ptr[-1] == '\r' && ptr[-2] == '\\'))
+                        ++line_no;
+                    else
+                        break;
+
+                f(unsigned(line - begin), unsigned(ptr - begin), directive_line, keyword);
+            }
+            else
+            {
+                // skip line, keeping track of block comments
+                for (; *ptr && *ptr != '\n'; ++ptr)
+                    if (in_comment && ptr[0] == '*' && ptr[1] == '/')
+                    {
+                        in_comment = false;
+                        ++ptr;
+                    }
+                    else if (!in_comment && ptr[0] == '/' && ptr[1] == '/')
+                    {
+                        while (ptr[1] && ptr[1] != '\n')
+                            ++ptr;
+                    }
+                    else if (!in_comment && ptr[0] == '/' && ptr[1] == '*')
+                    {
+                        in_comment = true;
+                        ++ptr;
+                    }
+            }
+
+            if (*ptr == '\n')
+            {
+                ++ptr;
+                ++line_no;
+            }
+        }
+    }
+
+    struct directive
+    {
+        unsigned    begin, end, line;
+        std::string keyword;
+    };
+
+    std::vector<directive> get_directives(const std::string& source)
+    {
+        std::vector<directive> result;
+        for_each_directive(source, [&](unsigned begin, unsigned end, unsigned line,
+                                       const std::string& keyword) {
+            result.push_back({begin, end, line, keyword});
+        });
+        return result;
+    }
 
-    auto full_preprocessed = get_full_preprocess_output(p, c, full_path);
-    auto line_no           = 1u;
-    auto file_depth        = 0;
-    auto was_newl = true, in_c_comment = false, write_char = true;
-    for (auto ptr = full_preprocessed.c_str(); *ptr; ++ptr)
+    // returns the identifier following the keyword of a directive
+    std::string get_directive_argument(const std::string& source, const directive& d)
     {
-        if (*ptr == '\n')
+        auto ptr  = source.c_str() + d.begin;
+        auto last = source.c_str() + d.end;
+
+        ptr = std::find(ptr, last, '#');
+        for (auto identifiers = 0; ptr != last; ++identifiers)
         {
-            was_newl = true;
+            while (ptr != last && !std::isalpha(static_cast<unsigned char>(*ptr)) && *ptr != '_')
+                ++ptr;
+            auto begin = ptr;
+            while (ptr != last && (std::isalnum(static_cast<unsigned char>(*ptr)) || *ptr == '_'))
+                ++ptr;
+            if (identifiers == 1)
+                return std::string(begin, ptr);
         }
-        else if (in_c_comment && ptr[0] == '*' && ptr[1] == '/')
+        return "";
+    }
+
+    using range_list = std::vector<std::pair<unsigned, unsigned>>;
+
+    range_list get_skipped_ranges(CXTranslationUnit tu, CXFile file)
+    {
+        range_list result;
+
+        auto skipped = clang_getSkippedRanges(tu, file);
+        for (auto i = 0u; i != skipped->count; ++i)
         {
-            in_c_comment = false;
-            was_newl     = false;
-            // add an additional newline
-            // this allows using c style doc comments in macros
-            // normally macros would all be one line, so each entity gets the same comment
-            preprocessed += '\n';
-            fake_lines.push_back(line_no);
+            unsigned begin, end;
+            detail::get_range(skipped->ranges[i], begin, end);
+            result.emplace_back(begin, end);
         }
-        else if (*ptr == '/' && ptr[1] == '*')
+        clang_disposeSourceRangeList(skipped);
+
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    // whether the offset is in one of the sorted ranges
+    bool is_in_range(const range_list& ranges, unsigned offset)
+    {
+        auto iter = std::upper_bound(ranges.begin(), ranges.end(), offset,
+                                     [](unsigned value, const std::pair<unsigned, unsigned>& r) {
+                                         return value < r.first;
+                                     });
+        return iter != ranges.begin() && offset < std::prev(iter)->second;
+    }
+
+    // offset and name of #undef directives
+    using undef_list = std::vector<std::pair<unsigned, std::string>>;
+
+    // returns the #undef directives of a file outside of skipped blocks
+    undef_list get_undefs(CXTranslationUnit tu, CXFile file)
+    {
+        undef_list result;
+
+        std::string source;
+        if (!read_source(string(clang_getFileName(file)).c_str(), source)
+            || source.find("undef") == std::string::npos)
+            return result;
+
+        auto skipped = get_skipped_ranges(tu, file);
+        for (auto& d : get_directives(source))
+            if (d.keyword == "undef" && !is_in_range(skipped, d.begin))
+                result.emplace_back(d.begin, get_directive_argument(source, d));
+        return result;
+    }
+
+    struct pp_token
+    {
+        std::string spelling; // empty for placemarkers
+        CXTokenKind kind;
+        unsigned    offset;
+        bool        space_before; // whether there was whitespace before it in the source
+
+        pp_token() : kind(CXToken_Punctuation), offset(0u), space_before(false)
         {
-            in_c_comment = true;
-            was_newl     = false;
         }
-        else if (was_newl && !in_c_comment && *ptr == '#' && ptr[1] != 'p')
+
+        pp_token(std::string spelling, CXTokenKind kind, unsigned offset = 0u,
+                 bool space_before = false)
+        : spelling(std::move(spelling)), kind(kind), offset(offset), space_before(space_before)
         {
-            auto marker = parse_line_marker(ptr);
-            assert(*ptr == '\n');
+        }
+
+        bool is_identifier() const STANDARDESE_NOEXCEPT
+        {
+            return kind == CXToken_Identifier || kind == CXToken_Keyword;
+        }
+    };
+
+    std::vector<pp_token> tokenize(CXTranslationUnit tu, CXSourceRange range)
+    {
+        unsigned begin, end;
+        detail::get_range(range, begin, end);
+
+        CXToken* tokens;
+        unsigned no_tokens;
+        clang_tokenize(tu, range, &tokens, &no_tokens);
+
+        std::vector<pp_token> result;
+        result.reserve(no_tokens);
+        for (auto cur = tokens; cur != tokens + no_tokens; ++cur)
+        {
+            unsigned offset;
+            clang_getSpellingLocation(clang_getTokenLocation(tu, *cur), nullptr, nullptr, nullptr,
+                                      &offset);
+            // clang_tokenize() sometimes includes the token after the range
+            if (offset >= end)
+                break;
+
+            auto space = !result.empty()
+                         && offset > result.back().offset + result.back().spelling.size();
+            result.emplace_back(string(clang_getTokenSpelling(tu, *cur)).c_str(),
+                                clang_getTokenKind(*cur), offset, space);
+        }
 
-            if (marker.file_name == full_path)
+        if (tokens)
+            clang_disposeTokens(tu, tokens, no_tokens);
+        return result;
+    }
+
+    struct macro_info
+    {
+        cpp_cursor               definition;
+        std::vector<std::string> params;
+        std::vector<pp_token>    replacement;
+        bool                     function_like, variadic;
+        bool                     undefined; // #undef in its header after the definition
+
+        macro_info() : function_like(false), variadic(false), undefined(false)
+        {
+        }
+
+        std::size_t get_param(const pp_token& token) const STANDARDESE_NOEXCEPT
+        {
+            if (!token.is_identifier())
+                return params.size();
+            return std::size_t(std::find(params.begin(), params.end(), token.spelling)
+                               - params.begin());
+        }
+    };
+
+    macro_info parse_macro_info(CXTranslationUnit tu, cpp_cursor def)
+    {
+        macro_info result;
+        result.definition = def;
+
+        auto tokens = tokenize(tu, clang_getCursorExtent(def));
+        if (tokens.empty())
+            return result;
+
+        auto iter = std::next(tokens.begin()); // skip name
+#if CINDEX_VERSION_MINOR >= 33
+        result.function_like = clang_Cursor_isMacroFunctionLike(def) != 0u;
+#else
+        // function like if open parenthesis directly after name
+        result.function_like =
+            iter != tokens.end() && iter->spelling == "("
+            && tokens.front().offset + tokens.front().spelling.size() == iter->offset;
+#endif
+
+        if (result.function_like)
+        {
+            for (++iter; iter != tokens.end() && iter->spelling != ")"; ++iter)
             {
-                assert(file_depth <= 1);
-                file_depth = 0;
-                write_char = false;
+                if (iter->spelling == "...")
+                {
+                    result.variadic = true;
+                    if (iter[-1].spelling == "(" || iter[-1].spelling == ",")
+                        result.params.push_back("__VA_ARGS__");
+                    // else named variadic parameter, already added
+                }
+                else if (iter->is_identifier())
+                    result.params.push_back(iter->spelling);
+            }
+            if (iter != tokens.end())
+                ++iter;
+        }
+        result.replacement.assign(iter, tokens.end());
 
-                if (marker.none_set())
+        return result;
+    }
+
+    pp_token stringify(const std::vector<pp_token>& tokens)
+    {
+        std::string result = "\"";
+        for (auto& token : tokens)
+        {
+            if (token.kind == CXToken_Comment)
+                continue;
+            else if (result.size() > 1u && token.space_before)
+                // whitespace between tokens becomes a single space
+                result += ' ';
+
+            if (token.kind == CXToken_Literal)
+                for (auto c : token.spelling)
                 {
-                    if (line_no < marker.line)
+                    if (c == '"' || c == '\\')
+                        result += '\\';
+                    result += c;
+                }
+            else
+                result += token.spelling;
+        }
+        result += '"';
+
+        return pp_token(std::move(result), CXToken_Literal);
+    }
+
+    // handles ## and removes placemarkers
+    std::vector<pp_token> paste_tokens(const std::vector<pp_token>& tokens)
+    {
+        std::vector<pp_token> result;
+        result.reserve(tokens.size());
+        for (auto i = std::size_t(0); i != tokens.size(); ++i)
+        {
+            if (tokens[i].spelling == "##" && !result.empty() && i + 1 != tokens.size())
+            {
+                auto& lhs = result.back();
+                auto& rhs = tokens[++i];
+                if (lhs.spelling == ",")
+                {
+                    // GNU extension: , ## __VA_ARGS__ removes the comma for empty arguments
+                    if (rhs.spelling.empty())
+                        result.pop_back();
+                    else
+                        result.push_back(rhs);
+                }
+                else
+                {
+                    if (lhs.spelling.empty())
+                        lhs.kind = rhs.kind;
+                    lhs.spelling += rhs.spelling;
+                }
+            }
+            else
+                result.push_back(tokens[i]);
+        }
+
+        // remove placemarkers, their whitespace goes to the next token
+        auto out   = result.begin();
+        auto space = false;
+        for (auto& token : result)
+        {
+            if (token.spelling.empty())
+                space = space || token.space_before;
+            else
+            {
+                token.space_before = token.space_before || space;
+                space              = false;
+                if (&*out != &token)
+                    *out = std::move(token);
+                ++out;
+            }
+        }
+        result.erase(out, result.end());
+        return result;
+    }
+
+    bool is_identifier_char(char c) STANDARDESE_NOEXCEPT
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    // whether the two tokens would form a different token without whitespace in between
+    bool would_paste(const std::string& lhs, const std::string& rhs) STANDARDESE_NOEXCEPT
+    {
+        if (lhs.empty() || rhs.empty())
+            return false;
+
+        auto last = lhs.back(), first = rhs.front();
+        if (is_identifier_char(first))
+            // identifiers, numbers and literal suffixes
+            return is_identifier_char(last) || last == '"' || last == '\'' || last == '.';
+        else if (first == '.')
+            return is_identifier_char(last) || last == '.';
+
+        static const char operator_chars[] = "+-*/%<>=!&|^#:";
+        return std::strchr(operator_chars, last) && std::strchr(operator_chars, first);
+    }
+
+    // sets the whitespace of the first token written since size
+    void set_space_before(std::vector<pp_token>& tokens, std::size_t size, bool space)
+    {
+        if (size != tokens.size())
+            tokens[size].space_before = space;
+    }
+
+    // expands the macros of the main file
+    // definitions and #undefs of the main file must be given in order of their offset,
+    // so that an expansion uses the definitions active at its position
+    class macro_expander
+    {
+    public:
+        macro_expander(CXTranslationUnit tu, CXFile main_file)
+        : tu_(tu), main_file_(main_file), next_undef_(0u), unsupported_(false)
+        {
+        }
+
+        void add_definition(cpp_cursor def)
+        {
+            definitions_[string(clang_getCursorSpelling(def)).c_str()] = def;
+        }
+
+        void add_undef(unsigned offset, std::string name)
+        {
+            undefs_.emplace_back(offset, std::move(name));
+        }
+
+        // removes the definitions undefined in the main file before the offset
+        void advance(unsigned offset)
+        {
+            for (; next_undef_ != undefs_.size() && undefs_[next_undef_].first < offset;
+                 ++next_undef_)
+                definitions_.erase(undefs_[next_undef_].second);
+        }
+
+        // writes the expansion of the given macro expansion cursor
+        // returns false if it cannot be expanded
+        bool expand(cpp_cursor expansion, std::string& result)
+        {
+            auto def = clang_getCursorReferenced(expansion);
+            if (clang_Cursor_isNull(def))
+            {
+                // builtin or command line macro, there is no definition to expand
+                unsupported_ = true;
+                return false;
+            }
+            // the referenced definition is the one active at that point
+            add_definition(def);
+
+            std::vector<pp_token>    expanded;
+            std::vector<std::string> disabled;
+            expand(tokenize(tu_, clang_getCursorExtent(expansion)), disabled, expanded);
+
+            for (auto& token : expanded)
+            {
+                if (!result.empty()
+                    && (token.space_before || would_paste(result, token.spelling)))
+                    result += ' ';
+
+                if (token.kind == CXToken_Comment && token.spelling.compare(0, 2, "//") == 0)
+                {
+                    // expansion is written in one line
+                    result += "/*";
+                    result.append(token.spelling, 2, std::string::npos);
+                    result += " */";
+                }
+                else
+                    result += token.spelling;
+            }
+
+            return !unsupported_;
+        }
+
+        // whether or not a macro uses features not supported by the expander,
+        // preprocessing needs to fall back to the external preprocessor then
+        bool unsupported() const STANDARDESE_NOEXCEPT
+        {
+            return unsupported_;
+        }
+
+    private:
+        const macro_info* lookup(const std::string& name)
+        {
+            auto def = definitions_.find(name);
+            if (def == definitions_.end())
+                return nullptr;
+
+            auto& info = macros_[name];
+            if (info.definition != def->second)
+            {
+                info           = parse_macro_info(tu_, def->second);
+                info.undefined = is_undefined_in_header(def->second, name);
+                for (auto& token : info.replacement)
+                    if (token.spelling == "__VA_OPT__")
+                        unsupported_ = true;
+            }
+            return info.undefined ? nullptr : &info;
+        }
+
+        // whether a definition in a header is undefined later in the same header,
+        // headers are always finished before a macro of the main file is expanded
+        // #undefs in other headers than the definition aren't detected
+        bool is_undefined_in_header(cpp_cursor def, const std::string& name)
+        {
+            CXFile   file;
+            unsigned offset;
+            clang_getSpellingLocation(clang_getCursorLocation(def), &file, nullptr, nullptr,
+                                      &offset);
+            if (!file || file == main_file_)
+                return false;
+
+            auto iter = header_undefs_.find(file);
+            if (iter == header_undefs_.end())
+                iter = header_undefs_.emplace(file, get_undefs(tu_, file)).first;
+            return std::any_of(iter->second.begin(), iter->second.end(),
+                               [&](const std::pair<unsigned, std::string>& undef) {
+                                   return undef.first > offset && undef.second == name;
+                               });
+        }
+
+        bool is_disabled(const std::vector<std::string>& disabled, const std::string& name) const
+        {
+            return std::find(disabled.begin(), disabled.end(), name) != disabled.end();
+        }
+
+        // reads the arguments of a function like macro starting at i,
+        // returns the index of the closing parenthesis or the size if it isn't an invocation
+        std::size_t read_arguments(const std::vector<pp_token>& input, std::size_t i,
+                                   std::vector<std::vector<pp_token>>& args) const
+        {
+            while (i != input.size() && input[i].kind == CXToken_Comment)
+                ++i;
+            if (i == input.size() || input[i].spelling != "(")
+                return input.size();
+
+            args.emplace_back();
+            auto depth = 0;
+            for (++i; i != input.size(); ++i)
+            {
+                auto& spelling = input[i].spelling;
+                if (spelling == ")" && depth == 0)
+                    return i;
+                else if (spelling == "," && depth == 0)
+                {
+                    args.emplace_back();
+                    continue;
+                }
+                else if (spelling == "(")
+                    ++depth;
+                else if (spelling == ")")
+                    --depth;
+                args.back().push_back(input[i]);
+            }
+
+            return input.size();
+        }
+
+        std::vector<pp_token> substitute(const macro_info& macro,
+                                         std::vector<std::vector<pp_token>> args,
+                                         std::vector<std::string>&          disabled)
+        {
+            if (macro.variadic && args.size() > macro.params.size())
+            {
+                // merge additional arguments into the variadic one
+                auto& variadic = args[macro.params.size() - 1];
+                for (auto iter = args.begin() + std::ptrdiff_t(macro.params.size());
+                     iter != args.end(); ++iter)
+                {
+                    variadic.emplace_back(",", CXToken_Punctuation);
+                    variadic.insert(variadic.end(), iter->begin(), iter->end());
+                }
+            }
+            args.resize(macro.params.size());
+
+            auto&                 replacement = macro.replacement;
+            std::vector<pp_token> result;
+            for (auto i = std::size_t(0); i != replacement.size(); ++i)
+            {
+                auto& token = replacement[i];
+                if (token.spelling == "#" && i + 1 != replacement.size())
+                {
+                    auto param = macro.get_param(replacement[i + 1]);
+                    if (param != macro.params.size())
                     {
-                        auto diff = marker.line - line_no;
-                        preprocessed.append(diff, '\n');
+                        result.push_back(stringify(args[param]));
+                        result.back().space_before = token.space_before;
+                        ++i;
+                        continue;
                     }
-                    line_no = marker.line;
                 }
+
+                auto param = macro.get_param(token);
+                auto size  = result.size();
+                if (param == macro.params.size())
+                    result.push_back(token);
+                else if ((i != 0u && replacement[i - 1].spelling == "##")
+                         || (i + 1 != replacement.size() && replacement[i + 1].spelling == "##"))
+                {
+                    // operand of ##, not macro expanded
+                    if (args[param].empty())
+                        result.emplace_back();
+                    else
+                        result.insert(result.end(), args[param].begin(), args[param].end());
+                }
+                else
+                    expand(args[param], disabled, result);
+                // the argument takes the whitespace of the parameter
+                set_space_before(result, size, token.space_before);
             }
-            else if (marker.is_set(line_marker::enter_new))
+
+            return paste_tokens(result);
+        }
+
+        void expand(const std::vector<pp_token>& input, std::vector<std::string>& disabled,
+                    std::vector<pp_token>& result)
+        {
+            for (auto i = std::size_t(0); i != input.size(); ++i)
             {
-                ++file_depth;
-                if (file_depth == 1 && marker.file_name != "<built-in>"
-                    && marker.file_name != "<command line>")
+                auto& token = input[i];
+                auto  macro = token.is_identifier() && !is_disabled(disabled, token.spelling) ?
+                                 lookup(token.spelling) :
+                                 nullptr;
+                auto size = result.size();
+                if (!macro)
+                    result.push_back(token);
+                else if (!macro->function_like)
                 {
-                    // write include
-                    preprocessed += "#include ";
-                    if (marker.is_set(line_marker::system))
-                        preprocessed += '<';
-                    else
-                        preprocessed += '"';
-                    preprocessed += marker.file_name;
-                    if (marker.is_set(line_marker::system))
-                        preprocessed += '>';
+                    disabled.push_back(token.spelling);
+                    expand(paste_tokens(macro->replacement), disabled, result);
+                    disabled.pop_back();
+                    // the expansion takes the whitespace of the macro name
+                    set_space_before(result, size, token.space_before);
+                }
+                else
+                {
+                    std::vector<std::vector<pp_token>> args;
+                    auto                               end = read_arguments(input, i + 1, args);
+                    if (end == input.size())
+                        // name without invocation
+                        result.push_back(token);
                     else
-                        preprocessed += '"';
-                    preprocessed += '\n';
-                    ++line_no;
-
-                    // also add include
-                    if (is_whitelisted_directory(marker.file_name))
-                        file.add_entity(
-                            cpp_inclusion_directive::make(file, marker.file_name,
-                                                          marker.is_set(line_marker::system) ?
-                                                              cpp_inclusion_directive::system :
-                                                              cpp_inclusion_directive::local,
-                                                          marker.line));
+                    {
+                        auto replacement = substitute(*macro, std::move(args), disabled);
+                        disabled.push_back(token.spelling);
+                        expand(replacement, disabled, result);
+                        disabled.pop_back();
+                        set_space_before(result, size, token.space_before);
+                        i = end;
+                    }
                 }
             }
-            else if (marker.is_set(line_marker::enter_old))
+        }
+
+        CXTranslationUnit                           tu_;
+        CXFile                                      main_file_;
+        std::unordered_map<std::string, cpp_cursor> definitions_;
+        std::unordered_map<std::string, macro_info> macros_;
+        undef_list                                  undefs_;
+        std::unordered_map<CXFile, undef_list>      header_undefs_;
+        std::size_t                                 next_undef_;
+        bool                                        unsupported_;
+    };
+
+    struct source_edit
+    {
+        unsigned    begin, end;
+        std::string replacement; // empty to remove
+
+        source_edit(unsigned begin, unsigned end, std::string replacement = "")
+        : begin(begin), end(end), replacement(std::move(replacement))
+        {
+        }
+    };
+
+    // replaces the edits, keeps the newlines of the replaced text
+    std::string apply_edits(const std::string& source, std::vector<source_edit>& edits)
+    {
+        std::stable_sort(edits.begin(), edits.end(),
+                         [](const source_edit& a, const source_edit& b) {
+                             return a.begin < b.begin;
+                         });
+
+        std::string result;
+        result.reserve(source.size());
+
+        auto pos = 0u;
+        for (auto& edit : edits)
+        {
+            if (edit.end <= pos)
+                // already replaced
+                continue;
+            else if (edit.begin < pos && !edit.replacement.empty())
+                // overlapping expansion, can't be applied
+                continue;
+
+            auto begin = std::max(edit.begin, pos);
+            result.append(source, pos, begin - pos);
+            result += edit.replacement;
+            result.append(std::size_t(std::count(source.begin() + begin,
+                                                 source.begin() + edit.end, '\n')),
+                          '\n');
+            pos = edit.end;
+        }
+        result.append(source, pos, std::string::npos);
+
+        return result;
+    }
+
+    // returns the length of the comments and directives at the beginning of the text,
+    // ends at the beginning of the line with the first other token
+    // this is the preamble libclang precompiles when reparsing
+    std::size_t get_preamble_length(const std::string& text)
+    {
+        auto begin      = text.c_str();
+        auto line_begin = begin;
+        for (auto ptr = begin; *ptr;)
+        {
+            if (*ptr == '\n')
+                line_begin = ++ptr;
+            else if (std::isspace(static_cast<unsigned char>(*ptr)))
+                ++ptr;
+            else if (ptr[0] == '/' && ptr[1] == '/')
+                ptr = std::strchr(ptr, '\n') ? std::strchr(ptr, '\n') : begin + text.size();
+            else if (ptr[0] == '/' && ptr[1] == '*')
             {
-                --file_depth;
+                auto end = std::strstr(ptr + 2, "*/");
+                if (!end)
+                    break;
+                ptr = end + 2;
             }
+            else if (*ptr == '#')
+            {
+                for (; *ptr && *ptr != '\n'; ++ptr)
+                    if (ptr[0] == '\\' && ptr[1] == '\n')
+                        ++ptr;
+            }
+            else
+                break;
         }
-        else
-            was_newl = false;
+        return std::size_t(line_begin - begin);
+    }
 
-        if (file_depth == 0 && write_char)
+    // removes carriage returns and moves the end of each C comment into a new line
+    // the first verbatim characters are kept as-is
+    std::string break_comments(const std::string& text, std::size_t verbatim,
+                               std::vector<unsigned>& fake_lines)
+    {
+        std::string result(text, 0u, verbatim);
+        result.reserve(text.size());
+
+        auto line_no      = 1u + unsigned(std::count(result.begin(), result.end(), '\n'));
+        auto in_c_comment = false;
+        for (auto ptr = text.c_str() + verbatim; *ptr; ++ptr)
         {
-            preprocessed += *ptr;
-            if (*ptr == '\n')
+            if (*ptr == '\r')
+                continue;
+            else if (*ptr == '\n')
                 ++line_no;
+            else if (in_c_comment && ptr[0] == '*' && ptr[1] == '/')
+            {
+                in_c_comment = false;
+                // this allows using c style doc comments in macros
+                // normally macros would all be one line, so each entity gets the same comment
+                result += '\n';
+                fake_lines.push_back(line_no);
+            }
+            else if (*ptr == '/' && ptr[1] == '*')
+                in_c_comment = true;
+
+            result += *ptr;
+        }
+
+        return result;
+    }
+
+    struct inclusion
+    {
+        std::string file_name;
+        unsigned    line;
+        bool        system;
+
+        inclusion(std::string file_name, unsigned line, bool system)
+        : file_name(std::move(file_name)), line(line), system(system)
+        {
+        }
+    };
+
+    // returns false if the file can't be preprocessed in-process
+    // if original is given, it is reparsed with the result,
+    // so the directives are kept and evaluated again and its preamble stays the same
+    // otherwise the includes are normalized and all conditionals removed
+    bool preprocess_in_process(const preprocessor& pp, const parser& p, const compile_config& c,
+                               const char* full_path, cpp_file& file, CXTranslationUnit original,
+                               std::string& result)
+    {
+        std::string source;
+        if (!read_source(full_path, source))
+            return false;
+
+        detail::tu_wrapper own_tu;
+        auto               tu = original;
+        if (!tu)
+        {
+            own_tu = detail::tu_wrapper(
+                get_cxunit(p.get_cxindex(), c, full_path, get_preprocessing_options()));
+            tu = own_tu.get();
         }
-        else if (file_depth == 0)
-            write_char = true;
+        auto keep_directives = original != nullptr;
+
+        auto cxfile = clang_getFile(tu, full_path);
+        if (!cxfile)
+            return false;
+
+        auto       skipped    = get_skipped_ranges(tu, cxfile);
+        auto       directives = get_directives(source);
+        range_list directive_ranges;
+        for (auto& d : directives)
+            directive_ranges.emplace_back(d.begin, d.end);
+
+        macro_expander expander(tu, cxfile);
+        for (auto& d : directives)
+            if (d.keyword == "undef" && !is_in_range(skipped, d.begin))
+                expander.add_undef(d.begin, get_directive_argument(source, d));
+
+        std::vector<source_edit>             edits;
+        std::unordered_map<unsigned, CXFile> includes;
+        detail::visit_children(clang_getTranslationUnitCursor(tu), [&](cpp_cursor cur,
+                                                                       cpp_cursor) {
+            auto kind = clang_getCursorKind(cur);
+            if (kind != CXCursor_MacroDefinition && kind != CXCursor_MacroExpansion
+                && kind != CXCursor_InclusionDirective)
+                return CXChildVisit_Continue;
+
+            CXFile   cur_file;
+            unsigned line, offset;
+            clang_getSpellingLocation(clang_getCursorLocation(cur), &cur_file, &line, nullptr,
+                                      &offset);
+            if (cur_file == cxfile)
+                expander.advance(offset);
+
+            if (kind == CXCursor_MacroDefinition)
+                expander.add_definition(cur);
+            else if (cur_file != cxfile)
+                return CXChildVisit_Continue;
+            else if (kind == CXCursor_InclusionDirective)
+                includes[line] = clang_getIncludedFile(cur);
+            else
+            {
+                unsigned    begin, end;
+                std::string expansion;
+                detail::get_range(clang_getCursorExtent(cur), begin, end);
+                if (is_in_range(directive_ranges, begin))
+                    // macro in a directive, evaluated by the preprocessor or removed
+                    return CXChildVisit_Continue;
+                else if (expander.expand(cur, expansion))
+                    edits.emplace_back(begin, end, std::move(expansion));
+            }
+            return CXChildVisit_Continue;
+        });
+        if (expander.unsupported())
+            return false;
+
+        for (auto& range : skipped)
+        {
+            if (!keep_directives)
+            {
+                edits.emplace_back(range.first, range.second);
+                continue;
+            }
+
+            // only remove the text between the directives
+            auto begin = range.first;
+            auto iter  = std::lower_bound(directive_ranges.begin(), directive_ranges.end(),
+                                         std::make_pair(range.first, 0u));
+            if (iter != directive_ranges.begin() && std::prev(iter)->second > range.first)
+                // range starts in the middle of a directive
+                --iter;
+            for (; iter != directive_ranges.end() && iter->first < range.second; ++iter)
+            {
+                if (begin < iter->first)
+                    edits.emplace_back(begin, iter->first);
+                begin = iter->second;
+            }
+            if (begin < range.second)
+                edits.emplace_back(begin, range.second);
+        }
+
+        std::vector<inclusion> inclusions;
+        for (auto& d : directives)
+        {
+            if (d.keyword == "pragma" || d.keyword == "define" || d.keyword == "undef")
+                // kept by the preprocessor as well
+                continue;
+            else if (d.keyword != "include" && d.keyword != "include_next"
+                     && d.keyword != "import")
+            {
+                if (!keep_directives)
+                    edits.emplace_back(d.begin, d.end);
+                continue;
+            }
+
+            auto iter = includes.find(d.line);
+            if (iter == includes.end() || !iter->second)
+            {
+                // include in a skipped block or file not found
+                if (!keep_directives)
+                    edits.emplace_back(d.begin, d.end);
+                continue;
+            }
+
+            string file_name(clang_getFileName(iter->second));
+            auto   system =
+                clang_Location_isInSystemHeader(clang_getLocationForOffset(tu, iter->second, 0u))
+                != 0;
+
+            if (!keep_directives)
+            {
+                std::string directive = "#include ";
+                directive += system ? '<' : '"';
+                directive += file_name.c_str();
+                directive += system ? '>' : '"';
+                edits.emplace_back(d.begin, d.end, std::move(directive));
+            }
+
+            inclusions.emplace_back(file_name.c_str(), d.line, system);
+        }
+
+        std::vector<unsigned> fake_lines;
+        auto                  edited = apply_edits(source, edits);
+        result = break_comments(edited, keep_directives ? get_preamble_length(edited) : 0u,
+                                fake_lines);
+
+        for (auto& incl : inclusions)
+            if (pp.is_whitelisted_directory(incl.file_name))
+                file.add_entity(
+                    cpp_inclusion_directive::make(file, std::move(incl.file_name),
+                                                  incl.system ? cpp_inclusion_directive::system :
+                                                                cpp_inclusion_directive::local,
+                                                  get_fake_line(fake_lines, incl.line)));
+
+        return true;
     }
+}
 
-    add_macros(p, c, full_path, file, fake_lines);
-    return preprocessed;
+std::string preprocessor::preprocess(const parser& p, const compile_config& c,
+                                     const char* full_path, cpp_file& file,
+                                     CXTranslationUnit tu) const
+{
+    if (!c.use_external_preprocessor())
+    {
+        try
+        {
+            std::string preprocessed;
+            if (preprocess_in_process(*this, p, c, full_path, file, tu, preprocessed))
+                return preprocessed;
+            p.get_logger()->debug("unable to preprocess '{}' in-process, using '{}'", full_path,
+                                  c.get_clang_binary());
+        }
+        catch (libclang_error& ex)
+        {
+            p.get_logger()->debug("unable to preprocess '{}' in-process ({}), using '{}'",
+                                  full_path, ex.what(), c.get_clang_binary());
+        }
+    }
+
+    return preprocess_external(*this, p, c, full_path, file);
 }
 
 void preprocessor::whitelist_include_dir(std::string dir)
@@ -418,3 +1466,10 @@ bool preprocessor::is_whitelisted_directory(std::string& dir) const STANDARDESE_
     }
     return false;
 }
+
+std::vector<std::string> preprocessor::get_whitelisted_directories() const
+{
+    std::vector<std::string> result(include_dirs_.begin(), include_dirs_.end());
+    std::sort(result.begin(), result.end());
+    return result;
+}
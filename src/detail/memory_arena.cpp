@@ -0,0 +1,157 @@
+// Copyright (C) 2016 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <standardese/detail/memory_arena.hpp>
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+
+using namespace standardese;
+
+struct detail::memory_arena::block
+{
+    block* next;
+};
+
+namespace
+{
+    const std::size_t block_size = 64u * 1024u;
+
+    // the arenas of the current thread
+    thread_local detail::memory_arena*
+        current_arena[static_cast<std::size_t>(detail::arena_kind::count)] = {};
+
+    detail::memory_arena*& get_current_arena(detail::arena_kind kind) STANDARDESE_NOEXCEPT
+    {
+        return current_arena[static_cast<std::size_t>(kind)];
+    }
+
+    // stored in front of memory from arena_allocate()
+    struct alignas(std::max_align_t) allocation_header
+    {
+        std::size_t size;
+        bool        in_arena;
+    };
+
+    allocation_header* get_header(void* ptr) STANDARDESE_NOEXCEPT
+    {
+        return static_cast<allocation_header*>(ptr) - 1;
+    }
+
+    char* align(char* ptr, std::size_t alignment) STANDARDESE_NOEXCEPT
+    {
+        auto address = reinterpret_cast<std::uintptr_t>(ptr);
+        auto rest    = address % alignment;
+        return rest == 0u ? ptr : ptr + (alignment - rest);
+    }
+}
+
+detail::memory_arena::~memory_arena() STANDARDESE_NOEXCEPT
+{
+    while (head_)
+    {
+        auto next = head_->next;
+        ::operator delete(head_);
+        head_ = next;
+    }
+}
+
+void* detail::memory_arena::allocate(std::size_t size, std::size_t alignment)
+{
+    assert(alignment != 0u && (alignment & (alignment - 1u)) == 0u);
+
+    if (cur_)
+    {
+        auto memory = align(cur_, alignment);
+        if (memory <= end_ && std::size_t(end_ - memory) >= size)
+        {
+            cur_ = memory + size;
+            return memory;
+        }
+    }
+
+    auto size_needed = sizeof(block) + alignment + size;
+    if (size_needed > block_size / 4u)
+        // big allocations get their own block, the current one is still used
+        return align(new_block(size_needed), alignment);
+
+    cur_        = new_block(block_size);
+    end_        = cur_ + (block_size - sizeof(block));
+    auto memory = align(cur_, alignment);
+    cur_        = memory + size;
+    return memory;
+}
+
+bool detail::memory_arena::in_current_block(const void* ptr) const STANDARDESE_NOEXCEPT
+{
+    if (!cur_)
+        return false;
+
+    auto begin = end_ - (block_size - sizeof(block));
+    auto p     = static_cast<const char*>(ptr);
+    // std::less as the pointers might not point into the same block
+    return !std::less<const char*>()(p, begin) && std::less<const char*>()(p, cur_);
+}
+
+char* detail::memory_arena::new_block(std::size_t size)
+{
+    auto result  = static_cast<block*>(::operator new(size));
+    result->next = head_;
+    head_        = result;
+    return reinterpret_cast<char*>(result) + sizeof(block);
+}
+
+detail::memory_arena* detail::memory_arena::get_current(arena_kind kind) STANDARDESE_NOEXCEPT
+{
+    return get_current_arena(kind);
+}
+
+detail::memory_arena_scope::memory_arena_scope(arena_kind kind, memory_arena* arena)
+    STANDARDESE_NOEXCEPT : prev_(get_current_arena(kind)),
+                           kind_(kind)
+{
+    get_current_arena(kind) = arena;
+}
+
+detail::memory_arena_scope::~memory_arena_scope() STANDARDESE_NOEXCEPT
+{
+    get_current_arena(kind_) = prev_;
+}
+
+void* detail::arena_allocate(arena_kind kind, std::size_t size)
+{
+    auto arena  = get_current_arena(kind);
+    auto memory = arena ? arena->allocate(sizeof(allocation_header) + size,
+                                          alignof(allocation_header)) :
+                          ::operator new(sizeof(allocation_header) + size);
+
+    auto header = ::new (memory) allocation_header{size, arena != nullptr};
+    return header + 1;
+}
+
+void* detail::arena_reallocate(arena_kind kind, void* ptr, std::size_t size)
+{
+    auto result = arena_allocate(kind, size);
+    if (ptr)
+    {
+        auto old_size = get_header(ptr)->size;
+        std::memcpy(result, ptr, old_size < size ? old_size : size);
+        arena_deallocate(ptr);
+    }
+    return result;
+}
+
+void detail::arena_deallocate(void* ptr) STANDARDESE_NOEXCEPT
+{
+    if (!ptr)
+        return;
+
+    // memory of an arena is freed together with it
+    auto header = get_header(ptr);
+    if (!header->in_arena)
+        ::operator delete(header);
+}
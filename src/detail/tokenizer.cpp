@@ -4,6 +4,8 @@
 
 #include <standardese/detail/tokenizer.hpp>
 
+#include <algorithm>
+
 #include <standardese/error.hpp>
 #include <standardese/translation_unit.hpp>
 
@@ -20,10 +22,64 @@ namespace
     }
 }
 
-detail::token::token(CXTranslationUnit tu, CXToken token)
-: detail::token(clang_getTokenSpelling(tu, token), clang_getTokenKind(token),
-                get_token_offset(tu, token))
+const string& detail::token::get_static_spelling(const char* str)
 {
+    static const string empty(std::string("")), semicolon(std::string(";")),
+        brace(std::string("{"));
+    if (*str == ';')
+        return semicolon;
+    else if (*str == '{')
+        return brace;
+    assert(!*str);
+    return empty;
+}
+
+std::size_t detail::token_buffer::spelling_hash::operator()(const string& str) const
+    STANDARDESE_NOEXCEPT
+{
+    // FNV-1a
+    std::size_t hash = 2166136261u;
+    for (auto c : str)
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+detail::token_buffer::token_buffer(CXTranslationUnit tu, CXSourceRange range)
+{
+    CXToken* tokens;
+    unsigned no_tokens;
+    clang_tokenize(tu, range, &tokens, &no_tokens);
+
+    tokens_.reserve(no_tokens);
+    for (auto cur = tokens; cur != tokens + no_tokens; ++cur)
+    {
+        string spelling(clang_getTokenSpelling(tu, *cur));
+
+        auto iter = spellings_.find(spelling);
+        if (iter == spellings_.end())
+            iter = spellings_.insert(spelling).first;
+
+        tokens_.emplace_back(*iter, clang_getTokenKind(*cur), get_token_offset(tu, *cur));
+    }
+
+    clang_disposeTokens(tu, tokens, no_tokens);
+}
+
+const detail::token* detail::token_buffer::lower_bound(unsigned offset) const STANDARDESE_NOEXCEPT
+{
+    return std::lower_bound(begin(), end(), offset, [](const token& t, unsigned offset) {
+        return t.get_offset() < offset;
+    });
+}
+
+const detail::token* detail::token_buffer::upper_bound(unsigned offset) const STANDARDESE_NOEXCEPT
+{
+    return std::upper_bound(begin(), end(), offset, [](unsigned offset, const token& t) {
+        return offset < t.get_offset();
+    });
 }
 
 namespace
@@ -43,23 +99,71 @@ namespace
         return clang_getLocationForOffset(tu, file, offset + inc);
     }
 
-    string get_token_after(CXTranslationUnit tu, CXFile file, CXSourceLocation loc)
+    // the tokens following the extent of a cursor
+    // uses the token buffer of the file if there is one,
+    // otherwise the rest of the file is tokenized once when needed
+    class following_tokens
     {
-        auto loc_after = get_next_location(tu, file, loc);
+    public:
+        following_tokens(CXTranslationUnit tu, CXFile file, const detail::token_buffer* buffer)
+        : tu_(tu), file_(file), buffer_(buffer)
+        {
+        }
+
+        // returns the first token at or after the location
+        const detail::token* at(CXSourceLocation loc)
+        {
+            unsigned offset;
+            clang_getSpellingLocation(loc, nullptr, nullptr, nullptr, &offset);
+            return get_buffer(loc).lower_bound(offset);
+        }
+
+        const detail::token* end() const STANDARDESE_NOEXCEPT
+        {
+            return buffer_ ? buffer_->end() : nullptr;
+        }
+
+        // returns the first token at or after begin with the given spelling
+        const detail::token* find(const detail::token* begin, const char* spelling) const
+        {
+            return std::find_if(begin, end(), [&](const detail::token& t) {
+                return t.get_value() == spelling;
+            });
+        }
+
+        CXSourceLocation get_location(const detail::token& t, unsigned inc = 0u) const
+        {
+            return clang_getLocationForOffset(tu_, file_, t.get_offset() + inc);
+        }
 
-        CXToken* token;
-        unsigned no;
-        clang_tokenize(tu, clang_getRange(loc, loc_after), &token, &no);
+    private:
+        const detail::token_buffer& get_buffer(CXSourceLocation loc)
+        {
+            if (!buffer_)
+            {
+                auto file_end =
+                    clang_getRangeEnd(clang_getCursorExtent(clang_getTranslationUnitCursor(tu_)));
+                own_buffer_.reset(new detail::token_buffer(tu_, clang_getRange(loc, file_end)));
+                buffer_ = own_buffer_.get();
+            }
+            return *buffer_;
+        }
 
-        assert(no >= 1);
-        string spelling(clang_getTokenSpelling(tu, token[0]));
+        CXTranslationUnit                     tu_;
+        CXFile                                file_;
+        const detail::token_buffer*           buffer_;
+        std::unique_ptr<detail::token_buffer> own_buffer_;
+    };
 
-        clang_disposeTokens(tu, token, no);
-        return spelling;
+    bool is_body_begin(const string& spelling)
+    {
+        // constructor initializer, function try block or regular body
+        return spelling == ":" || spelling == "try" || spelling == "{";
     }
 
     CXSourceRange get_extent(CXTranslationUnit tu, CXFile file, cpp_cursor cur,
-                             unsigned& end_offset, const char*& end_token)
+                             const detail::token_buffer* buffer, unsigned& end_offset,
+                             const char*& end_token)
     {
         end_token = ";";
 
@@ -68,6 +172,8 @@ namespace
         auto end          = clang_getRangeEnd(extent);
         auto range_shrunk = false;
 
+        // the fix-ups scan forward over the tokens after the extent
+        following_tokens tokens(tu, file, buffer);
         if (cursor_is_function(clang_getCursorKind(cur))
             || cursor_is_function(clang_getTemplateCursorKind(cur)))
         {
@@ -87,13 +193,23 @@ namespace
                 return CXChildVisit_Continue;
             });
 
-            if (!range_shrunk && get_token_after(tu, file, end) != ";")
+            auto next = range_shrunk ? tokens.end() : tokens.at(end);
+            if (next != tokens.end() && is_body_begin(next->get_value()))
+            {
+                // the body was skipped while parsing, so there is no child for it,
+                // but the extent ends right before it
+                end          = tokens.get_location(*next);
+                range_shrunk = true;
+                end_token    = "{";
+            }
+
+            if (next != tokens.end() && next->get_value() != ";" && !range_shrunk)
             {
                 // we do not have a body, but it is not a declaration either
-                do
-                {
-                    end = get_next_location(tu, file, end);
-                } while (get_token_after(tu, file, end) != ";");
+                // extend the range to the last token before the semicolon
+                auto semicolon = tokens.find(next, ";");
+                if (semicolon != tokens.end())
+                    end = tokens.get_location(semicolon[-1], 1u);
             }
             else if (clang_getCursorKind(cur) == CXCursor_CXXMethod)
                 // necessary for some reason
@@ -104,39 +220,40 @@ namespace
                  || clang_getCursorKind(cur) == CXCursor_TemplateTemplateParameter
                  || clang_getCursorKind(cur) == CXCursor_ParmDecl)
         {
-            if (clang_getCursorKind(cur) == CXCursor_TemplateTypeParameter
-                && get_token_after(tu, file, end) == "(")
+            auto next = clang_getCursorKind(cur) == CXCursor_TemplateTypeParameter ?
+                            tokens.at(end) :
+                            nullptr;
+            if (next && next != tokens.end() && next->get_value() == "(")
             {
                 // if you have decltype as default argument for a type template parameter
                 // libclang doesn't include the parameters
-                auto next = get_next_location(tu, file, end);
-                auto prev = end;
-                for (auto paren_count = 1; paren_count != 0;
-                     next             = get_next_location(tu, file, next))
+                auto paren_count = 1;
+                for (++next; next != tokens.end(); ++next)
                 {
-                    auto spelling = get_token_after(tu, file, next);
-                    if (spelling == "(")
+                    if (next->get_value() == "(")
                         ++paren_count;
-                    else if (spelling == ")")
-                        --paren_count;
-                    prev = next;
+                    else if (next->get_value() == ")" && --paren_count == 0)
+                    {
+                        end = tokens.get_location(*next);
+                        break;
+                    }
                 }
-                end = prev;
             }
             else
                 // range includes the following token ('>'/')' or ',') for (template) parameters
                 // don't need that
                 range_shrunk = true;
         }
-        else if (clang_getCursorKind(cur) == CXCursor_TypeAliasDecl
-                 && get_token_after(tu, file, end) != ";")
+        else if (clang_getCursorKind(cur) == CXCursor_TypeAliasDecl)
         {
-            // type alias tokens don't include everything
-            do
+            auto next = tokens.at(end);
+            if (next != tokens.end() && next->get_value() != ";")
             {
-                end = get_next_location(tu, file, end);
-            } while (get_token_after(tu, file, end) != ";");
-            end = get_next_location(tu, file, end);
+                // type alias tokens don't include everything
+                auto semicolon = tokens.find(next, ";");
+                if (semicolon != tokens.end())
+                    end = tokens.get_location(semicolon[-1], 2u);
+            }
         }
 
         clang_getSpellingLocation(end, nullptr, nullptr, nullptr, &end_offset);
@@ -146,18 +263,19 @@ namespace
         return clang_getRange(begin, end);
     }
 
-    CXSourceRange get_extent(CXTranslationUnit tu, CXFile file, cpp_cursor cur)
+    CXSourceRange get_extent(const translation_unit& tu, cpp_cursor cur)
     {
         unsigned    unused;
         const char* unused2;
-        return get_extent(tu, file, cur, unused, unused2);
+        return get_extent(tu.get_cxunit(), tu.get_cxfile(), cur, &tu.get_file().get_tokens(),
+                          unused, unused2);
     }
 }
 
 CXFile detail::get_range(const translation_unit& tu, cpp_cursor cur, unsigned& begin_offset,
                          unsigned& end_offset)
 {
-    auto source = get_extent(tu.get_cxunit(), tu.get_cxfile(), cur);
+    auto source = get_extent(tu, cur);
     return get_range(source, begin_offset, end_offset);
 }
 
@@ -179,39 +297,36 @@ CXFile detail::get_range(CXSourceRange extent, unsigned& begin_offset, unsigned&
 detail::tokenizer::tokenizer(CXTranslationUnit tu, CXFile file, cpp_cursor cur)
 : tu_(tu), file_(file)
 {
-    clang_tokenize(get_cxunit(), get_extent(get_cxunit(), get_cxfile(), cur, end_offset_, end_),
-                   &tokens_, &no_tokens_);
-    assert(tokens_);
-}
+    const char* end_token;
+    auto        extent =
+        get_extent(get_cxunit(), get_cxfile(), cur, nullptr, end_offset_, end_token);
 
-detail::tokenizer::~tokenizer() STANDARDESE_NOEXCEPT
-{
-    if (tokens_)
-        clang_disposeTokens(get_cxunit(), tokens_, no_tokens_);
+    own_buffer_.reset(new token_buffer(get_cxunit(), extent));
+    init(*own_buffer_, extent, end_token);
 }
 
-namespace
+detail::tokenizer::tokenizer(const translation_unit& tu, cpp_cursor cur)
+: tu_(tu.get_cxunit()), file_(tu.get_cxfile())
 {
-    CXToken* get_actual_end(CXTranslationUnit tu, CXToken* tokens, unsigned no_tokens,
-                            unsigned end_offset)
-    {
-        // need to find the last token that is actually part of the cursor
-        // libclang is always good with the extent of cursors
-        auto end = tokens + no_tokens;
-        while (get_token_offset(tu, end[-1]) > end_offset)
-        {
-            assert(end > tokens);
-            --end;
-        }
+    const char* end_token;
+    auto        extent = get_extent(get_cxunit(), get_cxfile(), cur, &tu.get_file().get_tokens(),
+                                    end_offset_, end_token);
 
-        return end;
-    }
+    init(tu.get_file().get_tokens(), extent, end_token);
 }
 
-detail::token_iterator detail::tokenizer::end() const STANDARDESE_NOEXCEPT
+void detail::tokenizer::init(const token_buffer& buffer, CXSourceRange extent,
+                             const char* end_token)
 {
-    auto end = get_actual_end(get_cxunit(), tokens_, no_tokens_, end_offset_);
-    return token_iterator(get_cxunit(), end);
+    unsigned begin_offset;
+    clang_getSpellingLocation(clang_getRangeStart(extent), nullptr, nullptr, nullptr,
+                              &begin_offset);
+
+    // the last token that is actually part of the cursor is given by the end offset,
+    // libclang isn't always good with the extent of cursors
+    begin_     = buffer.lower_bound(begin_offset);
+    end_       = std::max(begin_, buffer.upper_bound(end_offset_));
+    end_token_ = &token::get_static_spelling(end_token);
 }
 
 namespace
@@ -0,0 +1,761 @@
+// Copyright (C) 2016 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <standardese/doc_cache.hpp>
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <spdlog/fmt/fmt.h>
+
+#include <standardese/comment.hpp>
+#include <standardese/config.hpp>
+#include <standardese/doc_entity.hpp>
+#include <standardese/generator.hpp>
+#include <standardese/index.hpp>
+#include <standardese/md_blocks.hpp>
+#include <standardese/md_custom.hpp>
+#include <standardese/md_inlines.hpp>
+#include <standardese/parser.hpp>
+#include <standardese/translation_unit.hpp>
+
+using namespace standardese;
+
+namespace fs = boost::filesystem;
+
+namespace
+{
+    using hash_t = std::uint64_t;
+
+    constexpr hash_t fnv_basis = 14695981039346656037ull;
+    constexpr hash_t fnv_prime = 1099511628211ull;
+
+    // FNV-1a
+    hash_t hash(hash_t h, const char* data, std::size_t size) STANDARDESE_NOEXCEPT
+    {
+        for (auto end = data + size; data != end; ++data)
+        {
+            h ^= static_cast<unsigned char>(*data);
+            h *= fnv_prime;
+        }
+        return h;
+    }
+
+    hash_t hash(hash_t h, const std::string& str) STANDARDESE_NOEXCEPT
+    {
+        // include the null terminator, so that different splits give different hashes
+        return hash(h, str.c_str(), str.size() + 1u);
+    }
+
+    std::string to_hex(hash_t h)
+    {
+        return fmt::format("{:016x}", h);
+    }
+
+    bool read_file(const std::string& path, std::string& result)
+    {
+        std::ifstream file(path, std::ios_base::in | std::ios_base::binary);
+        if (!file.is_open())
+            return false;
+        result.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+        return true;
+    }
+
+    std::string get_content_hash(const std::string& path)
+    {
+        std::string content;
+        if (!read_file(path, content))
+            return "";
+        return to_hex(hash(fnv_basis, content.data(), content.size()));
+    }
+
+    // increment when the format changes
+    const char entry_magic[] = "standardese doc cache 2\n";
+
+    struct inclusion_data
+    {
+        const parser*            p;
+        CXTranslationUnit        tu;
+        std::vector<std::string> files;
+    };
+
+    void visit_inclusion(CXFile file, CXSourceLocation*, unsigned depth, CXClientData data)
+    {
+        if (depth == 0u)
+            // the main file
+            return;
+
+        auto& incl = *static_cast<inclusion_data*>(data);
+
+        std::string file_name = string(clang_getFileName(file)).c_str();
+        auto        dir       = file_name;
+        if (incl.p->get_preprocessor().is_whitelisted_directory(dir))
+            incl.files.push_back(std::move(file_name));
+    }
+
+    // the header itself and all whitelisted headers it includes
+    std::vector<std::string> get_dependencies(const parser& p, const translation_unit& tu)
+    {
+        inclusion_data data{&p, tu.get_cxunit(), {tu.get_path().c_str()}};
+        clang_getInclusions(tu.get_cxunit(), &visit_inclusion, &data);
+        return std::move(data.files);
+    }
+
+    // stands in for an entity of a cached file
+    // it provides everything needed for linking and the indices
+    class cached_entity final : public doc_entity, private doc_entity_container
+    {
+    public:
+        cached_entity(doc_entity::type t, const doc_entity* parent, const comment* c,
+                      cpp_entity::type cpp_type, std::string name, std::string index_name,
+                      std::string full_index_name, std::string unique_name)
+        : doc_entity(t, parent, c),
+          name_(std::move(name)),
+          index_name_(std::move(index_name)),
+          full_index_name_(std::move(full_index_name)),
+          unique_name_(std::move(unique_name)),
+          cpp_type_(cpp_type)
+        {
+        }
+
+        void add_entity(doc_entity_ptr e)
+        {
+            doc_entity_container::add_entity(std::move(e));
+        }
+
+        // the root owns the comments of all entities
+        void set_comments(std::vector<std::unique_ptr<comment>> comments)
+        {
+            comments_ = std::move(comments);
+        }
+
+        doc_entity_container::iterator begin() STANDARDESE_NOEXCEPT override
+        {
+            // like doc_file, the root forwards to the file entity
+            return is_root() ? doc_entity_container::begin()->begin() :
+                               doc_entity_container::begin();
+        }
+
+        doc_entity_container::iterator end() STANDARDESE_NOEXCEPT override
+        {
+            return is_root() ? doc_entity_container::begin()->end() : doc_entity_container::end();
+        }
+
+        doc_entity_container::const_iterator begin() const STANDARDESE_NOEXCEPT override
+        {
+            return is_root() ? doc_entity_container::begin()->begin() :
+                               doc_entity_container::begin();
+        }
+
+        doc_entity_container::const_iterator end() const STANDARDESE_NOEXCEPT override
+        {
+            return is_root() ? doc_entity_container::begin()->end() : doc_entity_container::end();
+        }
+
+    protected:
+        void do_generate_documentation(const parser&, const index&, md_document&,
+                                       unsigned) const override
+        {
+        }
+
+        void do_generate_synopsis(const parser&, code_block_writer&, bool) const override
+        {
+        }
+
+    private:
+        bool is_root() const STANDARDESE_NOEXCEPT
+        {
+            return get_entity_type() == doc_entity::file_t;
+        }
+
+        cpp_name do_get_name() const override
+        {
+            return name_;
+        }
+
+        cpp_name do_get_unique_name() const override
+        {
+            return unique_name_;
+        }
+
+        cpp_name do_get_index_name(bool full_name) const override
+        {
+            return full_name ? full_index_name_ : index_name_;
+        }
+
+        cpp_entity::type do_get_cpp_entity_type() const STANDARDESE_NOEXCEPT override
+        {
+            return cpp_type_;
+        }
+
+        std::vector<std::unique_ptr<comment>> comments_;
+        std::string                           name_, index_name_, full_index_name_, unique_name_;
+        cpp_entity::type                      cpp_type_;
+    };
+
+    bool is_registered(const doc_entity& e) STANDARDESE_NOEXCEPT
+    {
+        // see doc_file::parse()
+        return e.get_entity_type() == doc_entity::cpp_entity_t
+               && e.get_cpp_entity_type() != cpp_entity::access_specifier_t;
+    }
+
+    class entry_writer
+    {
+    public:
+        entry_writer(const doc_entity& root, const doc_entity& file) : root_(&root), file_(&file)
+        {
+            buffer_ = entry_magic;
+            assign_ids(root);
+        }
+
+        void write_number(std::size_t n)
+        {
+            buffer_ += std::to_string(n);
+            buffer_ += ' ';
+        }
+
+        void write_string(const char* str)
+        {
+            auto length = str ? std::strlen(str) : 0u;
+            write_number(length);
+            buffer_.append(str ? str : "", length);
+        }
+
+        void write_string(const std::string& str)
+        {
+            write_number(str.size());
+            buffer_ += str;
+        }
+
+        void write_entities()
+        {
+            write_number(comment_list_.size());
+            write_entity(*root_);
+            for (auto c : comment_list_)
+                write_comment(*c);
+        }
+
+        void write_document(const md_document& doc)
+        {
+            write_string(doc.get_output_name());
+            write_children(doc);
+        }
+
+        // the comments of the file that refer to an entity by name,
+        // entities of other files can use them
+        using name_comments = std::vector<std::pair<std::string, const comment*>>;
+
+        void write_name_comments(const char* file_name, const name_comments& comments)
+        {
+            write_string(file_name);
+            write_number(comments.size());
+            for (auto& c : comments)
+            {
+                write_string(c.first);
+                write_comment(*c.second);
+            }
+        }
+
+        const std::string& get_buffer() const STANDARDESE_NOEXCEPT
+        {
+            return buffer_;
+        }
+
+    private:
+        template <typename Func>
+        void for_each_child(const doc_entity& e, Func f)
+        {
+            if (&e == root_)
+                f(*file_);
+            else
+                for (auto& child : e)
+                    f(child);
+        }
+
+        // preorder, starting at 1
+        void assign_ids(const doc_entity& e)
+        {
+            ids_.emplace(&e, ids_.size() + 1u);
+            if (e.has_comment() && comments_.emplace(&e.get_comment(), comments_.size()).second)
+                comment_list_.push_back(&e.get_comment());
+            for_each_child(e, [&](const doc_entity& child) { assign_ids(child); });
+        }
+
+        std::string get_unique_name_suffix(const doc_entity& e) const
+        {
+            std::string result = e.get_unique_name().c_str();
+            if (e.has_comment() && e.get_comment().has_unique_name_override())
+                return result;
+
+            auto prefix = detail::get_unique_name(e.has_parent() ? &e.get_parent() : nullptr, "",
+                                                  nullptr);
+            return result.substr(std::strlen(prefix.c_str()));
+        }
+
+        void write_entity(const doc_entity& e)
+        {
+            write_number(e.get_entity_type());
+            write_number(e.get_cpp_entity_type());
+            write_string(e.get_name().c_str());
+            write_string(e.get_index_name(false).c_str());
+            write_string(e.get_index_name(true).c_str());
+            write_string(get_unique_name_suffix(e));
+            write_number(e.has_comment() ? comments_.at(&e.get_comment()) + 1u : 0u);
+            write_number(is_registered(e));
+
+            std::size_t no_children = 0u;
+            for_each_child(e, [&](const doc_entity&) { ++no_children; });
+            write_number(no_children);
+            for_each_child(e, [&](const doc_entity& child) { write_entity(child); });
+        }
+
+        void write_comment(const comment& c)
+        {
+            write_string(c.get_unique_name_override());
+            write_string(c.get_module());
+            write_string(c.get_group_name());
+            write_number(c.member_group_id());
+            write_number(c.is_excluded());
+            write_md(c.get_content());
+        }
+
+        void write_children(const md_container& container)
+        {
+            write_number(std::size_t(std::distance(container.begin(), container.end())));
+            for (auto& child : container)
+                write_md(child);
+        }
+
+        void write_md(const md_entity& e)
+        {
+            write_number(e.get_entity_type());
+            switch (e.get_entity_type())
+            {
+            case md_entity::comment_t:
+            {
+                auto& c    = static_cast<const md_comment&>(e);
+                auto  iter = c.has_entity() ? ids_.find(&c.get_entity()) : ids_.end();
+                write_number(iter == ids_.end() ? 0u : iter->second);
+                break;
+            }
+            case md_entity::list_t:
+            {
+                auto& list = static_cast<const md_list&>(e);
+                write_number(unsigned(list.get_list_type()));
+                write_number(unsigned(list.get_delimiter()));
+                write_number(unsigned(list.get_start()));
+                write_number(list.is_tight());
+                break;
+            }
+            case md_entity::code_block_t:
+            {
+                auto& code = static_cast<const md_code_block&>(e);
+                write_string(code.get_string());
+                write_string(code.get_fence_info());
+                break;
+            }
+            case md_entity::paragraph_t:
+            {
+                auto& par = static_cast<const md_paragraph&>(e);
+                write_number(unsigned(par.get_section_type()));
+                if (par.get_section_type() != section_type::invalid)
+                    write_string(par.get_section_text());
+                break;
+            }
+            case md_entity::heading_t:
+                write_number(unsigned(static_cast<const md_heading&>(e).get_level()));
+                break;
+            case md_entity::text_t:
+            case md_entity::code_t:
+                write_string(static_cast<const md_leave&>(e).get_string());
+                break;
+            case md_entity::link_t:
+            {
+                auto& link = static_cast<const md_link&>(e);
+                write_string(link.get_destination());
+                write_string(link.get_title());
+                break;
+            }
+            case md_entity::anchor_t:
+                write_string(static_cast<const md_anchor&>(e).get_id());
+                break;
+
+            default:
+                break;
+            }
+
+            if (is_container(e.get_entity_type()))
+                write_children(static_cast<const md_container&>(e));
+        }
+
+        std::string                                         buffer_;
+        const doc_entity*                                   root_;
+        const doc_entity*                                   file_;
+        std::unordered_map<const doc_entity*, std::size_t> ids_;
+        std::unordered_map<const comment*, std::size_t>    comments_;
+        std::vector<const comment*>                         comment_list_;
+    };
+
+    struct invalid_entry
+    {
+    };
+
+    class entry_reader
+    {
+    public:
+        explicit entry_reader(std::string buffer) : buffer_(std::move(buffer)), pos_(0u)
+        {
+        }
+
+        bool read_magic()
+        {
+            auto length = sizeof(entry_magic) - 1u;
+            if (buffer_.compare(0, length, entry_magic) != 0)
+                return false;
+            pos_ = length;
+            return true;
+        }
+
+        std::size_t read_number()
+        {
+            std::size_t result = 0u;
+            while (pos_ < buffer_.size() && std::isdigit(buffer_[pos_]))
+                result = result * 10u + std::size_t(buffer_[pos_++] - '0');
+            if (pos_ == buffer_.size() || buffer_[pos_] != ' ')
+                throw invalid_entry{};
+            ++pos_;
+            return result;
+        }
+
+        std::string read_string()
+        {
+            auto length = read_number();
+            if (buffer_.size() - pos_ < length)
+                throw invalid_entry{};
+            auto result = buffer_.substr(pos_, length);
+            pos_ += length;
+            return result;
+        }
+
+        doc_ptr<cached_entity> read_entities()
+        {
+            auto no_comments = read_number();
+            for (auto i = 0u; i != no_comments; ++i)
+                comments_.emplace_back(new comment);
+
+            auto root = read_entity(nullptr);
+
+            for (auto& c : comments_)
+                read_comment(*c);
+            root->set_comments(std::move(comments_));
+
+            return root;
+        }
+
+        md_ptr<md_document> read_document()
+        {
+            auto doc = md_document::make(read_string());
+            read_children(*doc);
+            return doc;
+        }
+
+        comment_registry::comment_list read_name_comments(std::string& file_name)
+        {
+            comment_registry::comment_list result;
+
+            file_name = read_string();
+            auto no_comments = read_number();
+            for (auto i = 0u; i != no_comments; ++i)
+            {
+                auto name = read_string();
+
+                comment c;
+                read_comment(c);
+                result.emplace_back(comment_id(name.c_str()), std::move(c));
+            }
+
+            return result;
+        }
+
+        // in the same order as doc_file::parse()
+        void register_entities(const parser& p, const index& i,
+                               const std::string& output_name) const
+        {
+            for (auto e : registered_)
+                i.register_entity(p, *e, output_name);
+        }
+
+    private:
+        doc_ptr<cached_entity> read_entity(const doc_entity* parent)
+        {
+            auto type = read_number();
+            if (type > doc_entity::member_group_t || (type == doc_entity::file_t) != !parent)
+                // only the root is a file
+                throw invalid_entry{};
+            auto cpp_type        = read_number();
+            auto name            = read_string();
+            auto index_name      = read_string();
+            auto full_index_name = read_string();
+            auto unique_name     = read_string();
+            auto comment_id      = read_number();
+            if (comment_id > comments_.size())
+                throw invalid_entry{};
+            auto registered = read_number() != 0u;
+
+            auto entity = detail::make_doc_ptr<
+                cached_entity>(doc_entity::type(type), parent,
+                               comment_id ? comments_[comment_id - 1u].get() : nullptr,
+                               cpp_entity::type(cpp_type), std::move(name), std::move(index_name),
+                               std::move(full_index_name), std::move(unique_name));
+            entities_.push_back(entity.get());
+
+            auto no_children = read_number();
+            if (type == doc_entity::file_t && no_children != 1u)
+                throw invalid_entry{};
+            for (auto i = 0u; i != no_children; ++i)
+                entity->add_entity(read_entity(entity.get()));
+
+            if (registered)
+                registered_.push_back(entity.get());
+            return entity;
+        }
+
+        void read_comment(comment& c)
+        {
+            c.set_unique_name_override(read_string());
+            c.set_module(read_string());
+            c.set_group_name(read_string());
+            c.add_to_member_group(read_number());
+            c.set_excluded(read_number() != 0u);
+
+            if (read_number() != md_entity::comment_t)
+                throw invalid_entry{};
+            c.set_content(read_md_comment());
+        }
+
+        md_ptr<md_comment> read_md_comment()
+        {
+            auto id = read_number();
+            if (id > entities_.size())
+                throw invalid_entry{};
+
+            auto result = md_comment::make();
+            // fall back to the file as context
+            result->set_entity(id ? *entities_[id - 1u] : *entities_.front());
+            read_children(*result);
+            return result;
+        }
+
+        void read_children(md_container& container)
+        {
+            auto no_children = read_number();
+            for (auto i = 0u; i != no_children; ++i)
+                container.add_entity(read_md(container));
+        }
+
+        template <typename T>
+        md_entity_ptr read_container(md_ptr<T> container)
+        {
+            read_children(*container);
+            return std::move(container);
+        }
+
+        md_entity_ptr read_md(const md_entity& parent)
+        {
+            switch (read_number())
+            {
+            case md_entity::comment_t:
+                return read_md_comment();
+            case md_entity::block_quote_t:
+                return read_container(md_block_quote::make(parent));
+            case md_entity::list_t:
+            {
+                auto type  = md_list_type(read_number());
+                auto delim = md_list_delimiter(read_number());
+                auto start = int(read_number());
+                auto tight = read_number() != 0u;
+                return read_container(md_list::make(parent, type, delim, start, tight));
+            }
+            case md_entity::list_item_t:
+                return read_container(md_list_item::make(parent));
+            case md_entity::code_block_t:
+            {
+                auto code  = read_string();
+                auto fence = read_string();
+                return md_code_block::make(parent, code.c_str(), fence.c_str());
+            }
+            case md_entity::paragraph_t:
+            {
+                auto par  = md_paragraph::make(parent);
+                auto type = section_type(read_number());
+                if (type != section_type::invalid)
+                    par->set_section_type(type, read_string());
+                return read_container(std::move(par));
+            }
+            case md_entity::heading_t:
+                return read_container(md_heading::make(parent, int(read_number())));
+            case md_entity::thematic_break_t:
+                return md_thematic_break::make(parent);
+            case md_entity::inline_documentation_t:
+            {
+                detail::md_arena_scope arena_scope(parent);
+                return read_container(detail::make_md_ptr<md_inline_documentation>(parent));
+            }
+
+            case md_entity::text_t:
+                return md_text::make(parent, read_string().c_str());
+            case md_entity::soft_break_t:
+                return md_soft_break::make(parent);
+            case md_entity::line_break_t:
+                return md_line_break::make(parent);
+            case md_entity::code_t:
+                return md_code::make(parent, read_string().c_str());
+            case md_entity::emphasis_t:
+                return read_container(md_emphasis::make(parent));
+            case md_entity::strong_t:
+                return read_container(md_strong::make(parent));
+            case md_entity::link_t:
+            {
+                auto destination = read_string();
+                auto title       = read_string();
+                return read_container(md_link::make(parent, destination.c_str(), title.c_str()));
+            }
+            case md_entity::anchor_t:
+                return md_anchor::make(parent, read_string().c_str());
+            }
+
+            throw invalid_entry{};
+        }
+
+        std::string                           buffer_;
+        std::size_t                           pos_;
+        std::vector<std::unique_ptr<comment>> comments_;
+        std::vector<const doc_entity*>        entities_;
+        std::vector<const doc_entity*>        registered_;
+    };
+} // namespace
+
+doc_cache::doc_cache(std::string directory, std::string configuration)
+: directory_(std::move(directory)), configuration_(std::move(configuration)), hits_(0u), misses_(0u)
+{
+    fs::create_directories(directory_);
+}
+
+documentation doc_cache::lookup(const parser& p, const index& i, const compile_config& c,
+                                const char* full_path, const std::string& output_name)
+{
+    std::string buffer;
+    if (!read_file(get_entry_path(c, full_path, output_name), buffer))
+    {
+        ++misses_;
+        return documentation(nullptr, nullptr);
+    }
+
+    try
+    {
+        entry_reader reader(std::move(buffer));
+        if (!reader.read_magic())
+            throw invalid_entry{};
+
+        auto no_dependencies = reader.read_number();
+        for (auto n = 0u; n != no_dependencies; ++n)
+        {
+            auto path = reader.read_string();
+            auto content_hash = reader.read_string();
+            if (get_content_hash(path) != content_hash)
+            {
+                p.get_logger()->debug("documentation of '{}' is outdated, '{}' has changed",
+                                      full_path, path);
+                ++misses_;
+                return documentation(nullptr, nullptr);
+            }
+        }
+
+        auto file_name     = reader.read_string();
+        auto file          = reader.read_entities();
+        auto doc           = reader.read_document();
+        std::string source_name;
+        auto        name_comments = reader.read_name_comments(source_name);
+        // only register once everything was read successfully
+        reader.register_entities(p, i, file_name);
+        p.get_comment_registry().register_comments(std::move(name_comments), source_name.c_str());
+
+        ++hits_;
+        return documentation(std::move(file), std::move(doc));
+    }
+    catch (invalid_entry&)
+    {
+        p.get_logger()->warn("invalid documentation cache entry for '{}'", full_path);
+    }
+
+    ++misses_;
+    return documentation(nullptr, nullptr);
+}
+
+void doc_cache::store(const parser& p, const compile_config& c, const translation_unit& tu,
+                      const std::string& output_name, const documentation& doc)
+{
+    if (!doc.file || !doc.document)
+        return;
+    assert(doc.file->get_entity_type() == doc_entity::file_t);
+    auto& file = static_cast<const doc_file&>(*doc.file);
+
+    entry_writer writer(file, *file.file_);
+
+    auto dependencies = get_dependencies(p, tu);
+    writer.write_number(dependencies.size());
+    for (auto& path : dependencies)
+    {
+        writer.write_string(path);
+        writer.write_string(get_content_hash(path));
+    }
+
+    writer.write_string(file.get_file_name().c_str());
+    writer.write_entities();
+    writer.write_document(*doc.document);
+    auto source_name = tu.get_file().get_name();
+    writer.write_name_comments(source_name.c_str(),
+                               p.get_comment_registry().get_name_comments(source_name.c_str()));
+
+    // write into a temporary file first, so that other processes never see partial entries
+    auto path = get_entry_path(c, tu.get_path().c_str(), output_name);
+    auto tmp  = fs::unique_path(path + ".%%%%-%%%%").string();
+    {
+        std::ofstream out(tmp, std::ios_base::out | std::ios_base::binary);
+        out << writer.get_buffer();
+        if (!out)
+        {
+            p.get_logger()->warn("unable to write documentation cache entry '{}'", tmp);
+            return;
+        }
+    }
+
+    boost::system::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec)
+    {
+        p.get_logger()->warn("unable to write documentation cache entry '{}' ({})", path,
+                             ec.message());
+        fs::remove(tmp, ec);
+    }
+}
+
+std::string doc_cache::get_entry_path(const compile_config& c, const char* full_path,
+                                      const std::string& output_name) const
+{
+    auto h = hash(fnv_basis, configuration_);
+    for (auto flag : c.get_flags(full_path))
+        h = hash(h, flag, std::strlen(flag) + 1u);
+    h = hash(h, full_path, std::strlen(full_path) + 1u);
+    h = hash(h, output_name);
+
+    return (fs::path(directory_) / (to_hex(h) + ".cache")).string();
+}
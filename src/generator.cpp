@@ -17,12 +17,21 @@ standardese::documentation standardese::generate_doc_file(const parser& p, const
                                                           const cpp_file& f, std::string name)
 {
     auto file = doc_file::parse(p, i, std::move(name), f);
-
-    auto doc = md_document::make(std::string("doc_") + file->get_file_name().c_str());
-    file->generate_documentation(p, i, *doc);
+    auto doc  = generate_doc_document(p, i, *file);
     return {std::move(file), std::move(doc)};
 }
 
+md_ptr<md_document> standardese::generate_doc_document(const parser& p, const index& i,
+                                                       const doc_entity& file)
+{
+    assert(file.get_entity_type() == doc_entity::file_t);
+    auto& f = static_cast<const doc_file&>(file);
+
+    auto doc = md_document::make(std::string("doc_") + f.get_file_name().c_str());
+    f.generate_documentation(p, i, *doc);
+    return doc;
+}
+
 namespace
 {
     using standardese::index;
@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstring>
 #include <spdlog/fmt/fmt.h>
 
 #include <standardese/comment.hpp>
@@ -58,13 +59,143 @@ std::string detail::get_short_id(const std::string& id)
     return result;
 }
 
+// the id of a unique name that is split into multiple parts,
+// as if detail::get_id() was called on their concatenation
+class index::id_view
+{
+public:
+    explicit id_view(const char* str) : id_view(str, "", "")
+    {
+    }
+
+    id_view(const char* scope, const char* separator, const char* name) : no_parts_(0u)
+    {
+        add_part(scope);
+        add_part(separator);
+        add_part(name);
+
+        if (no_parts_ == 0u)
+            return;
+
+        // ignore trailing ()
+        auto& last       = parts_[no_parts_ - 1u];
+        auto  skip_space = [&](const char* ptr) {
+            while (ptr != last.begin && is_id_space(ptr[-1]))
+                --ptr;
+            return ptr;
+        };
+        auto end = skip_space(last.end);
+        if (end != last.begin && end[-1] == ')')
+        {
+            auto before = skip_space(end - 1);
+            if (before != last.begin && before[-1] == '(')
+                last.end = before - 1;
+        }
+    }
+
+    // calls f for each character of the id until it returns false
+    template <typename Func>
+    bool visit(Func f) const
+    {
+        for (auto i = 0u; i != no_parts_; ++i)
+            for (auto ptr = parts_[i].begin; ptr != parts_[i].end; ++ptr)
+                if (!is_id_space(*ptr) && !f(*ptr))
+                    return false;
+        return true;
+    }
+
+    int compare(const std::string& id) const STANDARDESE_NOEXCEPT
+    {
+        auto cur    = id.begin();
+        auto result = 0;
+        visit([&](char c) {
+            if (cur == id.end())
+                result = 1;
+            else if (*cur != c)
+                result = std::char_traits<char>::lt(*cur, c) ? 1 : -1;
+            else
+            {
+                ++cur;
+                return true;
+            }
+            return false;
+        });
+
+        if (result == 0 && cur != id.end())
+            result = -1;
+        return result;
+    }
+
+private:
+    static bool is_id_space(char c) STANDARDESE_NOEXCEPT
+    {
+        return std::isspace(c) != 0;
+    }
+
+    void add_part(const char* str) STANDARDESE_NOEXCEPT
+    {
+        if (*str)
+            parts_[no_parts_++] = part{str, str + std::strlen(str)};
+    }
+
+    struct part
+    {
+        const char* begin;
+        const char* end;
+    };
+
+    part        parts_[3];
+    std::size_t no_parts_;
+};
+
+namespace
+{
+    const std::size_t fnv_basis = 2166136261u;
+
+    std::size_t hash_char(std::size_t hash, char c) STANDARDESE_NOEXCEPT
+    {
+        // FNV-1a
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+        return hash;
+    }
+
+    // continues hashing with the characters of the id
+    template <class IdView>
+    std::size_t hash_id(std::size_t hash, const IdView& id) STANDARDESE_NOEXCEPT
+    {
+        id.visit([&](char c) {
+            hash = hash_char(hash, c);
+            return true;
+        });
+        return hash;
+    }
+
+    // the unique name without whitespace
+    std::string get_scope_id(const char* unique_name)
+    {
+        std::string result;
+        for (auto ptr = unique_name; *ptr; ++ptr)
+            if (!std::isspace(*ptr))
+                result += *ptr;
+        return result;
+    }
+}
+
 void index::register_entity(const parser& p, const doc_entity& entity,
                             std::string output_file) const
 {
-    auto id       = detail::get_id(entity.get_unique_name().c_str());
+    assert(!frozen_);
+    auto scope_id = get_scope_id(entity.get_unique_name().c_str());
+    auto id       = detail::get_id(scope_id);
     auto short_id = detail::get_short_id(id);
 
+    auto scope_hash = fnv_basis;
+    for (auto c : scope_id)
+        scope_hash = hash_char(scope_hash, c);
+
     std::lock_guard<std::mutex> lock(mutex_);
+    scopes_.emplace(&entity, scope{std::move(scope_id), scope_hash});
 
     // insert short id if it doesn't exist
     // otherwise erase
@@ -90,9 +221,12 @@ void index::register_entity(const parser& p, const doc_entity& entity,
     else if (pair.first->second.second->get_cpp_entity_type() == cpp_entity::file_t)
     {
         using value_type = decltype(files_)::value_type;
-        auto pos         = std::lower_bound(files_.begin(), files_.end(), pair.first,
-                                    [](value_type a, value_type b) { return a->first < b->first; });
-        files_.insert(pos, pair.first);
+        auto& file_id    = pair.first->first;
+        auto  pos        = std::lower_bound(files_.begin(), files_.end(), file_id,
+                                    [](const value_type& a, const std::string& b) {
+                                        return a.first < b;
+                                    });
+        files_.emplace(pos, file_id, &entity);
     }
 
     if (entity.in_module())
@@ -104,8 +238,56 @@ void index::register_entity(const parser& p, const doc_entity& entity,
     linker_.register_entity(entity, std::move(output_file));
 }
 
+void index::freeze()
+{
+    if (frozen_)
+        return;
+
+    table_.reserve(entities_.size());
+    for (auto& pair : entities_)
+        table_.push_back(entry{pair.first, pair.second.second,
+                               hash_id(fnv_basis, id_view(pair.first.c_str())),
+                               pair.second.first});
+    entities_.clear();
+
+    // open addressing with linear probing, at most half full
+    auto no_buckets = std::size_t(16u);
+    while (no_buckets < 2u * table_.size())
+        no_buckets *= 2u;
+    buckets_.assign(no_buckets, 0u);
+    for (auto i = 0u; i != table_.size(); ++i)
+    {
+        auto bucket = table_[i].hash & (no_buckets - 1u);
+        while (buckets_[bucket] != 0u)
+            bucket = (bucket + 1u) & (no_buckets - 1u);
+        buckets_[bucket] = i + 1u;
+    }
+
+    frozen_ = true;
+}
+
+const doc_entity* index::lookup_id(std::size_t hash, const id_view& id) const STANDARDESE_NOEXCEPT
+{
+    assert(frozen_);
+    for (auto bucket = hash & (buckets_.size() - 1u); buckets_[bucket] != 0u;
+         bucket      = (bucket + 1u) & (buckets_.size() - 1u))
+    {
+        auto& e = table_[buckets_[bucket] - 1u];
+        if (e.hash == hash && id.compare(e.id) == 0)
+            return e.entity;
+    }
+
+    return nullptr;
+}
+
 const doc_entity* index::try_lookup(const std::string& unique_name) const
 {
+    if (frozen_)
+    {
+        id_view id(unique_name.c_str());
+        return lookup_id(hash_id(fnv_basis, id), id);
+    }
+
     std::lock_guard<std::mutex> lock(mutex_);
     auto                        iter = entities_.find(detail::get_id(unique_name));
     return iter == entities_.end() ? nullptr : iter->second.second;
@@ -113,8 +295,29 @@ const doc_entity* index::try_lookup(const std::string& unique_name) const
 
 const doc_entity& index::lookup(const std::string& unique_name) const
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return *entities_.at(detail::get_id(unique_name)).second;
+    auto entity = try_lookup(unique_name);
+    if (!entity)
+        throw std::out_of_range(fmt::format("unknown entity '{}'", unique_name));
+    return *entity;
+}
+
+const doc_entity* index::lookup_relative(const doc_entity& scope, const char* separator,
+                                         const char* name) const
+{
+    assert(frozen_);
+
+    auto iter = scopes_.find(&scope);
+    if (iter == scopes_.end())
+    {
+        // not registered, need to compute the unique name
+        auto    unique_name = scope.get_unique_name();
+        id_view id(unique_name.c_str(), separator, name);
+        return lookup_id(hash_id(fnv_basis, id), id);
+    }
+
+    // continue the hash of the scope with the rest
+    id_view id(iter->second.id.c_str(), separator, name);
+    return lookup_id(hash_id(iter->second.hash, id_view("", separator, name)), id);
 }
 
 const doc_entity* index::try_name_lookup(const doc_entity&  context,
@@ -122,6 +325,19 @@ const doc_entity* index::try_name_lookup(const doc_entity&  context,
 {
     if (unique_name.front() == '?' || unique_name.front() == '*')
     {
+        if (frozen_)
+        {
+            // same as below, but with the precomputed scopes
+            if (auto entity = lookup_relative(context, ".", unique_name.c_str() + 1))
+                return entity;
+
+            for (auto cur = &context; cur; cur = cur->has_parent() ? &cur->get_parent() : nullptr)
+                if (auto entity = lookup_relative(*cur, "::", unique_name.c_str() + 1))
+                    return entity;
+
+            return try_lookup(unique_name);
+        }
+
         // first try parameter/base
         auto name =
             std::string(context.get_unique_name().c_str()) + "." + (unique_name.c_str() + 1);
@@ -152,16 +368,12 @@ const doc_entity& index::name_lookup(const doc_entity&  context,
 
 void index::namespace_member_impl(ns_member_cb cb, void* data)
 {
-    for (auto& pair : entities_)
-    {
-        auto& value = pair.second;
-        if (value.first)
-            continue; // ignore short names
-
-        auto& entity = *value.second;
-        if (entity.get_cpp_entity_type() == cpp_entity::namespace_t
-            || entity.get_cpp_entity_type() == cpp_entity::file_t)
-            continue;
+    auto handle = [&](bool is_short, const doc_entity& entity) {
+        if (is_short)
+            return; // ignore short names
+        else if (entity.get_cpp_entity_type() == cpp_entity::namespace_t
+                 || entity.get_cpp_entity_type() == cpp_entity::file_t)
+            return;
 
         assert(entity.has_parent());
         auto* parent = &entity.get_parent();
@@ -176,5 +388,12 @@ void index::namespace_member_impl(ns_member_cb cb, void* data)
             cb(parent, entity, data);
         else if (parent_type == cpp_entity::file_t)
             cb(nullptr, entity, data);
-    }
+    };
+
+    if (frozen_)
+        for (auto& e : table_)
+            handle(e.is_short, *e.entity);
+    else
+        for (auto& pair : entities_)
+            handle(pair.second.first, *pair.second.second);
 }
@@ -96,8 +96,15 @@ namespace
     }
 }
 
+std::unique_lock<std::mutex> linker::lock() const
+{
+    // once frozen, the tables aren't modified anymore
+    return frozen_ ? std::unique_lock<std::mutex>() : std::unique_lock<std::mutex>(mutex_);
+}
+
 void linker::register_entity(const doc_entity& e, std::string output_file) const
 {
+    assert(!frozen_);
     auto loc = location(get_documented_entity(e), "doc_" + std::move(output_file));
 
     std::unique_lock<std::mutex> lock(mutex_);
@@ -109,6 +116,7 @@ void linker::register_entity(const doc_entity& e, std::string output_file) const
 
 std::string linker::register_anchor(const std::string& unique_name, std::string output_file) const
 {
+    assert(!frozen_);
     location loc(unique_name.c_str(), std::move(output_file));
     {
         std::unique_lock<std::mutex> lock(mutex_);
@@ -121,6 +129,7 @@ std::string linker::register_anchor(const std::string& unique_name, std::string
 
 void linker::change_output_file(const doc_entity& e, std::string output_file) const
 {
+    assert(!frozen_);
     std::unique_lock<std::mutex> lock(mutex_);
     locations_.at(&e).set_output_file(std::move(output_file));
 }
@@ -134,8 +143,8 @@ std::string linker::get_url(const index& idx, const doc_entity* context,
         return get_url(*entity, extension);
 
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        auto                         iter = anchors_.find(unique_name);
+        auto lock = this->lock();
+        auto iter = anchors_.find(unique_name);
         if (iter != anchors_.end())
             return iter->second.format(extension);
     }
@@ -148,13 +157,13 @@ std::string linker::get_url(const index& idx, const doc_entity* context,
 
 std::string linker::get_url(const doc_entity& e, const char* extension) const
 {
-    std::unique_lock<std::mutex> lock(mutex_);
+    auto lock = this->lock();
     return locations_.at(&e).format(extension);
 }
 
 std::string linker::get_anchor_id(const doc_entity& e) const
 {
-    std::unique_lock<std::mutex> lock(mutex_);
+    auto lock = this->lock();
     return locations_.at(&e).get_id();
 }
 
@@ -188,7 +197,9 @@ void linker::location::set_output_file(std::string output_file)
 
 std::string linker::location::format(const char* extension) const
 {
-    auto result = file_name_;
+    std::string result;
+    result.reserve(file_name_.size() + std::strlen(extension) + id_.size() + 2u);
+    result += file_name_;
 
     if (!with_extension_)
     {
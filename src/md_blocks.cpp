@@ -20,7 +20,8 @@ md_ptr<md_block_quote> md_block_quote::parse(cmark_node* cur, const md_entity& p
 
 md_ptr<md_block_quote> md_block_quote::make(const md_entity& parent)
 {
-    auto node = cmark_node_new(CMARK_NODE_BLOCK_QUOTE);
+    detail::md_arena_scope arena_scope(parent);
+    auto node = cmark_node_new_with_mem(CMARK_NODE_BLOCK_QUOTE, detail::get_cmark_mem());
     if (!node)
         throw cmark_error("md_block_quote::make");
     return detail::make_md_ptr<md_block_quote>(node, parent);
@@ -46,7 +47,8 @@ md_ptr<md_list> md_list::parse(cmark_node* cur, const md_entity& parent)
 md_ptr<md_list> md_list::make(const md_entity& parent, md_list_type type, md_list_delimiter delim,
                               int start, bool is_tight)
 {
-    auto node = cmark_node_new(CMARK_NODE_LIST);
+    detail::md_arena_scope arena_scope(parent);
+    auto node = cmark_node_new_with_mem(CMARK_NODE_LIST, detail::get_cmark_mem());
     if (!node)
         throw cmark_error("md_list::make");
 
@@ -145,7 +147,8 @@ md_ptr<md_list_item> md_list_item::parse(cmark_node* cur, const md_entity& paren
 
 md_ptr<md_list_item> md_list_item::make(const md_entity& parent)
 {
-    auto node = cmark_node_new(CMARK_NODE_ITEM);
+    detail::md_arena_scope arena_scope(parent);
+    auto node = cmark_node_new_with_mem(CMARK_NODE_ITEM, detail::get_cmark_mem());
     if (!node)
         throw cmark_error("md_list_item::make");
     return detail::make_md_ptr<md_list_item>(node, parent);
@@ -183,7 +186,8 @@ md_ptr<md_code_block> md_code_block::parse(cmark_node* cur, const md_entity& par
 md_ptr<standardese::md_code_block> md_code_block::make(const md_entity& parent, const char* code,
                                                        const char* fence)
 {
-    auto node = cmark_node_new(CMARK_NODE_CODE_BLOCK);
+    detail::md_arena_scope arena_scope(parent);
+    auto node = cmark_node_new_with_mem(CMARK_NODE_CODE_BLOCK, detail::get_cmark_mem());
     if (!node)
         throw cmark_error("md_code_block::make");
     if (!cmark_node_set_literal(node, code))
@@ -212,7 +216,8 @@ md_ptr<md_paragraph> md_paragraph::parse(cmark_node* cur, const md_entity& paren
 
 md_ptr<md_paragraph> md_paragraph::make(const md_entity& parent)
 {
-    auto node = cmark_node_new(CMARK_NODE_PARAGRAPH);
+    detail::md_arena_scope arena_scope(parent);
+    auto node = cmark_node_new_with_mem(CMARK_NODE_PARAGRAPH, detail::get_cmark_mem());
     if (!node)
         throw cmark_error("md_paragraph::make");
     return detail::make_md_ptr<md_paragraph>(node, parent);
@@ -235,6 +240,12 @@ void md_paragraph::set_section_type(section_type t, const std::string& name)
     }
 }
 
+const char* md_paragraph::get_section_text() const STANDARDESE_NOEXCEPT
+{
+    assert(section_type_ != section_type::invalid);
+    return section_->get_section_text();
+}
+
 md_entity_ptr md_paragraph::do_clone(const md_entity* parent) const
 {
     assert(parent);
@@ -242,7 +253,7 @@ md_entity_ptr md_paragraph::do_clone(const md_entity* parent) const
     auto result = make(*parent);
 
     if (section_type_ != section_type::invalid)
-        result->set_section_type(section_type_, section_->get_section_text());
+        result->set_section_type(section_type_, get_section_text());
 
     auto skip_soft_break = false;
     for (auto& child : *this)
@@ -282,7 +293,8 @@ md_ptr<md_heading> md_heading::parse(cmark_node* cur, const md_entity& parent)
 
 md_ptr<md_heading> md_heading::make(const md_entity& parent, int level)
 {
-    auto node = cmark_node_new(CMARK_NODE_HEADING);
+    detail::md_arena_scope arena_scope(parent);
+    auto node = cmark_node_new_with_mem(CMARK_NODE_HEADING, detail::get_cmark_mem());
     if (!node)
         throw cmark_error("md_heading::make");
     if (!cmark_node_set_heading_level(node, level))
@@ -314,7 +326,8 @@ md_ptr<md_thematic_break> md_thematic_break::parse(cmark_node* cur, const md_ent
 
 md_ptr<md_thematic_break> md_thematic_break::make(const md_entity& parent)
 {
-    auto node = cmark_node_new(CMARK_NODE_THEMATIC_BREAK);
+    detail::md_arena_scope arena_scope(parent);
+    auto node = cmark_node_new_with_mem(CMARK_NODE_THEMATIC_BREAK, detail::get_cmark_mem());
     if (!node)
         throw cmark_error("md_thematic_break::make");
     return detail::make_md_ptr<md_thematic_break>(node, parent);
@@ -14,6 +14,7 @@ using namespace standardese;
 
 md_ptr<md_section> md_section::make(const md_entity& parent, const std::string& section_text)
 {
+    detail::md_arena_scope arena_scope(parent);
     return detail::make_md_ptr<md_section>(parent, section_text);
 }
 
@@ -43,7 +44,8 @@ md_entity_ptr md_section::do_clone(const md_entity* parent) const
 }
 
 md_section::md_section(const md_entity& parent, const std::string& section_text)
-: md_container(get_entity_type(), cmark_node_new(CMARK_NODE_CUSTOM_INLINE), parent)
+: md_container(get_entity_type(),
+               cmark_node_new_with_mem(CMARK_NODE_CUSTOM_INLINE, detail::get_cmark_mem()), parent)
 {
     auto emphasis = md_emphasis::make(*this, section_text.c_str());
     add_entity(std::move(emphasis));
@@ -55,6 +57,7 @@ md_section::md_section(const md_entity& parent, const std::string& section_text)
 md_ptr<md_inline_documentation> md_inline_documentation::make(const md_entity&   parent,
                                                               const std::string& heading)
 {
+    detail::md_arena_scope arena_scope(parent);
     auto res = detail::make_md_ptr<md_inline_documentation>(parent);
 
     // heading
@@ -126,13 +129,18 @@ md_entity_ptr md_inline_documentation::do_clone(const md_entity* parent) const
 }
 
 md_inline_documentation::md_inline_documentation(const md_entity& parent)
-: md_container(get_entity_type(), cmark_node_new(CMARK_NODE_CUSTOM_BLOCK), parent)
+: md_container(get_entity_type(),
+               cmark_node_new_with_mem(CMARK_NODE_CUSTOM_BLOCK, detail::get_cmark_mem()), parent)
 {
 }
 
 md_ptr<md_document> md_document::make(std::string name)
 {
-    return detail::make_md_ptr<md_document>(cmark_node_new(CMARK_NODE_DOCUMENT), std::move(name));
+    // the document can't be part of its own arena
+    detail::memory_arena_scope arena_scope(detail::arena_kind::md_entity, nullptr);
+
+    auto node = cmark_node_new_with_mem(CMARK_NODE_DOCUMENT, detail::get_cmark_mem());
+    return detail::make_md_ptr<md_document>(node, std::move(name));
 }
 
 md_entity_ptr md_document::do_clone(const md_entity* parent) const
@@ -5,11 +5,16 @@
 #include <standardese/md_entity.hpp>
 
 #include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
 #include <cmark.h>
 #include <spdlog/fmt/fmt.h>
 
 #include <standardese/error.hpp>
 #include <standardese/md_blocks.hpp>
+#include <standardese/md_custom.hpp>
 #include <standardese/md_inlines.hpp>
 
 using namespace standardese;
@@ -58,6 +63,94 @@ md_entity_ptr md_entity::try_parse(cmark_node* cur, const md_entity& parent)
                               line, column);
 }
 
+namespace
+{
+    // cmark is written in C, so can't propagate exceptions
+    void out_of_memory() STANDARDESE_NOEXCEPT
+    {
+        std::fputs("[standardese] out of memory for cmark, aborting\n", stderr);
+        std::abort();
+    }
+
+    void* cmark_calloc(std::size_t count, std::size_t size) STANDARDESE_NOEXCEPT
+    {
+        try
+        {
+            auto memory = detail::arena_allocate(detail::arena_kind::md_entity, count * size);
+            std::memset(memory, 0, count * size);
+            return memory;
+        }
+        catch (std::bad_alloc&)
+        {
+            out_of_memory();
+            return nullptr;
+        }
+    }
+
+    void* cmark_realloc(void* ptr, std::size_t size) STANDARDESE_NOEXCEPT
+    {
+        try
+        {
+            return detail::arena_reallocate(detail::arena_kind::md_entity, ptr, size);
+        }
+        catch (std::bad_alloc&)
+        {
+            out_of_memory();
+            return nullptr;
+        }
+    }
+
+    void cmark_free(void* ptr) STANDARDESE_NOEXCEPT
+    {
+        detail::arena_deallocate(ptr);
+    }
+}
+
+cmark_mem* detail::get_cmark_mem() STANDARDESE_NOEXCEPT
+{
+    static cmark_mem mem = {cmark_calloc, cmark_realloc, cmark_free};
+    return &mem;
+}
+
+void* md_entity::operator new(std::size_t size)
+{
+    return detail::arena_allocate(detail::arena_kind::md_entity, size);
+}
+
+void md_entity::operator delete(void* ptr) STANDARDESE_NOEXCEPT
+{
+    detail::arena_deallocate(ptr);
+}
+
+detail::md_arena_scope::md_arena_scope(const md_entity& parent) STANDARDESE_NOEXCEPT
+    : scope_(arena_kind::md_entity, get_arena(parent))
+{
+}
+
+detail::memory_arena* detail::md_arena_scope::get_arena(const md_entity& parent)
+    STANDARDESE_NOEXCEPT
+{
+    auto root = &parent;
+    while (root->has_parent())
+        root = &root->get_parent();
+    if (root->get_entity_type() != md_entity::document_t)
+        return nullptr;
+
+    auto arena   = &static_cast<const md_document&>(*root).arena;
+    auto current = memory_arena::get_current(arena_kind::md_entity);
+    // nested entities must belong to the document whose arena is already active,
+    // otherwise they would be freed together with the wrong document
+    assert(!current || current == arena);
+    (void)current;
+    return arena;
+}
+
+md_entity_ptr md_entity::clone(const md_entity& parent) const
+{
+    detail::md_arena_scope arena_scope(parent);
+    return do_clone(&parent);
+}
+
 md_entity::~md_entity() STANDARDESE_NOEXCEPT
 {
     if (cmark_node_parent(node_) == nullptr)
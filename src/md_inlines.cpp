@@ -21,7 +21,8 @@ md_ptr<md_text> md_text::parse(cmark_node* cur, const md_entity& parent)
 
 md_ptr<md_text> md_text::make(const md_entity& parent, const char* text)
 {
-    auto node = cmark_node_new(CMARK_NODE_TEXT);
+    detail::md_arena_scope arena_scope(parent);
+    auto node = cmark_node_new_with_mem(CMARK_NODE_TEXT, detail::get_cmark_mem());
     if (!node)
         throw cmark_error("md_text::make");
     if (!cmark_node_set_literal(node, text))
@@ -43,7 +44,8 @@ md_ptr<md_soft_break> md_soft_break::parse(cmark_node* cur, const md_entity& par
 
 md_ptr<md_soft_break> md_soft_break::make(const md_entity& parent)
 {
-    auto node = cmark_node_new(CMARK_NODE_SOFTBREAK);
+    detail::md_arena_scope arena_scope(parent);
+    auto node = cmark_node_new_with_mem(CMARK_NODE_SOFTBREAK, detail::get_cmark_mem());
     if (!node)
         throw cmark_error("md_soft_break::make");
     return detail::make_md_ptr<md_soft_break>(node, parent);
@@ -63,7 +65,8 @@ md_ptr<md_line_break> md_line_break::parse(cmark_node* cur, const md_entity& par
 
 md_ptr<md_line_break> md_line_break::make(const md_entity& parent)
 {
-    auto node = cmark_node_new(CMARK_NODE_LINEBREAK);
+    detail::md_arena_scope arena_scope(parent);
+    auto node = cmark_node_new_with_mem(CMARK_NODE_LINEBREAK, detail::get_cmark_mem());
     if (!node)
         throw cmark_error("md_line_break::make");
     return detail::make_md_ptr<md_line_break>(node, parent);
@@ -83,7 +86,8 @@ md_ptr<md_code> md_code::parse(cmark_node* cur, const md_entity& parent)
 
 md_ptr<md_code> md_code::make(const md_entity& parent, const char* code)
 {
-    auto node = cmark_node_new(CMARK_NODE_CODE);
+    detail::md_arena_scope arena_scope(parent);
+    auto node = cmark_node_new_with_mem(CMARK_NODE_CODE, detail::get_cmark_mem());
     if (!node)
         throw cmark_error("md_code::make");
     if (!cmark_node_set_literal(node, code))
@@ -105,7 +109,8 @@ md_ptr<md_emphasis> md_emphasis::parse(cmark_node* cur, const md_entity& parent)
 
 md_ptr<md_emphasis> md_emphasis::make(const md_entity& parent)
 {
-    auto node = cmark_node_new(CMARK_NODE_EMPH);
+    detail::md_arena_scope arena_scope(parent);
+    auto node = cmark_node_new_with_mem(CMARK_NODE_EMPH, detail::get_cmark_mem());
     if (!node)
         throw cmark_error("md_emphasis::make");
     return detail::make_md_ptr<md_emphasis>(node, parent);
@@ -113,6 +118,7 @@ md_ptr<md_emphasis> md_emphasis::make(const md_entity& parent)
 
 md_ptr<md_emphasis> md_emphasis::make(const md_entity& parent, const char* str)
 {
+    detail::md_arena_scope arena_scope(parent);
     auto emph = make(parent);
 
     auto text = md_text::make(*emph, str);
@@ -140,7 +146,8 @@ md_ptr<md_strong> md_strong::parse(cmark_node* cur, const md_entity& parent)
 
 md_ptr<md_strong> md_strong::make(const md_entity& parent)
 {
-    auto node = cmark_node_new(CMARK_NODE_STRONG);
+    detail::md_arena_scope arena_scope(parent);
+    auto node = cmark_node_new_with_mem(CMARK_NODE_STRONG, detail::get_cmark_mem());
     if (!node)
         throw cmark_error("md_strong::make");
     return detail::make_md_ptr<md_strong>(node, parent);
@@ -148,6 +155,7 @@ md_ptr<md_strong> md_strong::make(const md_entity& parent)
 
 md_ptr<md_strong> md_strong::make(const md_entity& parent, const char* str)
 {
+    detail::md_arena_scope arena_scope(parent);
     auto strong = make(parent);
 
     auto text = md_text::make(*strong, str);
@@ -175,7 +183,8 @@ md_ptr<md_link> md_link::parse(cmark_node* cur, const md_entity& parent)
 
 md_ptr<md_link> md_link::make(const md_entity& parent, const char* destination, const char* title)
 {
-    auto node = cmark_node_new(CMARK_NODE_LINK);
+    detail::md_arena_scope arena_scope(parent);
+    auto node = cmark_node_new_with_mem(CMARK_NODE_LINK, detail::get_cmark_mem());
     if (!node)
         throw cmark_error("md_link::make");
     if (!cmark_node_set_url(node, destination))
@@ -223,7 +232,8 @@ namespace
 
 md_ptr<md_anchor> md_anchor::make(const md_entity& parent, const char* id)
 {
-    auto node = cmark_node_new(CMARK_NODE_HTML_INLINE);
+    detail::md_arena_scope arena_scope(parent);
+    auto node = cmark_node_new_with_mem(CMARK_NODE_HTML_INLINE, detail::get_cmark_mem());
     if (!node)
         throw cmark_error("md_anchor::make");
     if (!cmark_node_set_literal(node, make_id(id).c_str()))
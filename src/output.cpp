@@ -4,10 +4,14 @@
 
 #include <standardese/output.hpp>
 
+#include <algorithm>
+#include <functional>
+#include <mutex>
 #include <stack>
 #include <spdlog/logger.h>
 
 #include <standardese/comment.hpp>
+#include <standardese/error.hpp>
 #include <standardese/generator.hpp>
 #include <standardese/index.hpp>
 #include <standardese/linker.hpp>
@@ -77,22 +81,62 @@ namespace
         return text.get_string();
     }
 
-    void resolve_urls(const std::shared_ptr<spdlog::logger>& logger, const index& i,
-                      md_document& document, const char* extension)
+    // the links of a document are changed while it is rendered,
+    // so renderings of the same document must not overlap
+    std::mutex& get_render_mutex(const md_document& document)
     {
-        for_each_entity_reference(document, [&](const doc_entity* context, md_link& link) {
-            auto str = get_entity_name(link);
-            if (str.empty())
-                return;
-
-            auto destination = i.get_linker().get_url(i, context, str, extension);
-            if (destination.empty())
-                logger->warn("unable to resolve link to an entity named '{}'", str);
-            else
-                link.set_destination(destination.c_str());
-        });
+        static std::mutex mutexes[64];
+        return mutexes[std::hash<const md_document*>()(&document) % 64];
     }
 
+    // sets the destinations of the entity links to their URLs,
+    // the original destinations are restored in the destructor
+    // the document is locked for the lifetime of the resolver
+    class url_resolver
+    {
+    public:
+        url_resolver(const std::shared_ptr<spdlog::logger>& logger, const index& i,
+                     md_document& document, const char* extension)
+        : lock_(get_render_mutex(document))
+        {
+            for_each_entity_reference(document, [&](const doc_entity* context, md_link& link) {
+                auto str = get_entity_name(link);
+                if (str.empty())
+                    return;
+
+                auto destination = i.get_linker().get_url(i, context, str, extension);
+                if (destination.empty())
+                    logger->warn("unable to resolve link to an entity named '{}'", str);
+                else
+                {
+                    links_.emplace_back(&link, link.get_destination());
+                    link.set_destination(destination.c_str());
+                }
+            });
+        }
+
+        url_resolver(const url_resolver&) = delete;
+        url_resolver& operator=(const url_resolver&) = delete;
+
+        ~url_resolver() STANDARDESE_NOEXCEPT
+        {
+            for (auto& link : links_)
+                try
+                {
+                    link.first->set_destination(link.second.c_str());
+                }
+                catch (cmark_error&)
+                {
+                    // can only fail if it isn't a link
+                    assert(false);
+                }
+        }
+
+    private:
+        std::unique_lock<std::mutex>                  lock_;
+        std::vector<std::pair<md_link*, std::string>> links_;
+    };
+
     std::string normalize_escape(const cpp_name& name)
     {
         std::string result;
@@ -123,6 +167,21 @@ void standardese::normalize_urls(const index& idx, md_container& document,
     });
 }
 
+std::vector<std::string> standardese::get_entity_urls(const index& idx, const md_document& doc,
+                                                     const char* extension)
+{
+    std::vector<std::string> result;
+    // the document is only read
+    for_each_entity_reference(const_cast<md_document&>(doc),
+                              [&](const doc_entity* context, const md_link& link) {
+                                  auto str = get_entity_name(link);
+                                  if (!str.empty())
+                                      result.push_back(
+                                          idx.get_linker().get_url(idx, context, str, extension));
+                              });
+    return result;
+}
+
 raw_document::raw_document(path fname, std::string text)
 : file_name(std::move(fname)), text(std::move(text))
 {
@@ -134,27 +193,43 @@ raw_document::raw_document(path fname, std::string text)
     }
 }
 
-void output::render(const std::shared_ptr<spdlog::logger>& logger, const md_document& doc,
+void output::render(const std::shared_ptr<spdlog::logger>& logger, md_document& document,
                     const char* output_extension)
 {
     if (!output_extension)
         output_extension = format_->extension();
 
-    auto document = md_ptr<md_document>(static_cast<md_document*>(doc.clone().release()));
-    resolve_urls(logger, *index_, *document, output_extension);
-
-    file_output output(prefix_ + document->get_output_name() + '.' + output_extension);
-    format_->render(output, *document);
+    // resolve the links in place instead of rendering a copy
+    url_resolver resolver(logger, *index_, document, output_extension);
+    write(document, output_extension);
 }
 
-void output::render_template(const std::shared_ptr<spdlog::logger>& logger,
-                             const template_file& templ, const documentation& doc,
-                             const char* output_extension)
+void output::render(const std::shared_ptr<spdlog::logger>& logger, md_document& document,
+                    const std::vector<output>& outputs, const char* output_extension)
 {
-    auto document      = process_template(*parser_, *index_, templ, format_, &doc);
-    document.file_name = doc.document->get_output_name();
+    std::vector<bool> written(outputs.size(), false);
+    for (auto i = 0u; i != outputs.size(); ++i)
+    {
+        if (written[i])
+            continue;
+
+        auto extension = output_extension ? output_extension : outputs[i].format_->extension();
+        url_resolver resolver(logger, *outputs[i].index_, document, extension);
+        for (auto j = i; j != outputs.size(); ++j)
+            if (!written[j]
+                && (output_extension
+                    || std::strcmp(outputs[j].format_->extension(), extension) == 0))
+            {
+                outputs[j].write(document, extension);
+                written[j] = true;
+            }
+    }
+}
 
-    render_raw(logger, document, output_extension);
+void output::write(const md_document& document, const char* output_extension) const
+{
+    file_output output(prefix_ + document.get_output_name() + '.' + output_extension);
+    format_->render(output, document);
 }
 
 namespace
@@ -202,6 +277,125 @@ namespace
         }
         return result;
     }
+
+    // resolves the standardese:// URLs while writing to another output,
+    // an URL that isn't complete yet is kept until the next write
+    class link_output : public output_stream_base
+    {
+    public:
+        link_output(const std::shared_ptr<spdlog::logger>& logger, const index& idx,
+                    const char* extension, output_stream_base& output) STANDARDESE_NOEXCEPT
+            : logger_(&logger),
+              index_(&idx),
+              extension_(extension),
+              output_(&output)
+        {
+        }
+
+        // writes the remaining characters
+        void finish()
+        {
+            auto pending = std::move(pending_);
+            pending_.clear();
+            write_resolved(pending.data(), pending.data() + pending.size(), true);
+        }
+
+    private:
+        void do_write(const char* str, std::size_t n) override
+        {
+            static const auto prefix_length = sizeof(link_prefix) - 1u;
+
+            auto end = str + n;
+            while (!pending_.empty() && str != end)
+            {
+                // complete the incomplete URL with the new data up to the end of the entity name
+                auto missing =
+                    pending_.size() < prefix_length ? prefix_length - pending_.size() : 0u;
+                auto name_end =
+                    std::find(str + std::min(missing, std::size_t(end - str)), end, '/');
+                auto rest = name_end == end ? end : name_end + 1;
+
+                auto pending = std::move(pending_);
+                pending_.clear();
+                pending.append(str, rest);
+                write_resolved(pending.data(), pending.data() + pending.size(), false);
+                str = rest;
+            }
+
+            // the remaining data is written directly
+            if (str != end)
+                write_resolved(str, end, false);
+        }
+
+        void write_resolved(const char* begin, const char* end, bool last)
+        {
+            static const auto prefix_length = sizeof(link_prefix) - 1u;
+            while (begin != end)
+            {
+                auto match = std::search(begin, end, link_prefix, link_prefix + prefix_length);
+                if (match == end)
+                {
+                    // keep a possible beginning of an URL
+                    auto rest = last ? end : end - get_prefix_length(begin, end);
+                    output_->write_str(begin, std::size_t(rest - begin));
+                    pending_.assign(rest, end);
+                    return;
+                }
+                output_->write_str(begin, std::size_t(match - begin));
+
+                auto entity_name = match + prefix_length;
+                auto name_end    = std::find(entity_name, end, '/');
+                if (name_end == end && !last)
+                {
+                    pending_.assign(match, end);
+                    return;
+                }
+
+                auto name = unescape(entity_name, name_end);
+                auto url  = index_->get_linker().get_url(*index_, nullptr, name, extension_);
+                if (url.empty())
+                {
+                    (*logger_)->warn("unable to resolve link to an entity named '{}'", name);
+                    output_->write_str(match, prefix_length);
+                    begin = entity_name;
+                }
+                else
+                {
+                    output_->write_str(url.c_str(), url.size());
+                    begin = name_end == end ? end : name_end + 1;
+                }
+            }
+        }
+
+        // returns the length of the longest suffix that is the beginning of the prefix
+        static std::size_t get_prefix_length(const char* begin, const char* end)
+        {
+            auto max = std::min(std::size_t(end - begin), sizeof(link_prefix) - 2u);
+            for (auto length = max; length != 0u; --length)
+                if (std::equal(end - length, end, link_prefix))
+                    return length;
+            return 0u;
+        }
+
+        const std::shared_ptr<spdlog::logger>* logger_;
+        const index*                           index_;
+        const char*                            extension_;
+        output_stream_base*                    output_;
+        std::string                            pending_;
+    };
+}
+
+void output::render_template(const std::shared_ptr<spdlog::logger>& logger,
+                             const compiled_template& templ, const documentation& doc,
+                             const char* output_extension)
+{
+    if (!output_extension)
+        output_extension = format_->extension();
+
+    file_output file(prefix_ + doc.document->get_output_name() + '.' + format_->extension());
+    link_output output(logger, *index_, output_extension, file);
+    process_template(output, *parser_, *index_, templ, format_, &doc);
+    output.finish();
 }
 
 void output::render_raw(const std::shared_ptr<spdlog::logger>& logger, const raw_document& document,
@@ -212,35 +406,8 @@ void output::render_raw(const std::shared_ptr<spdlog::logger>& logger, const raw
 
     auto extension =
         document.file_extension.empty() ? format_->extension() : document.file_extension;
-    file_output output(prefix_ + document.file_name + '.' + extension);
-
-    auto last_match = document.text.c_str();
-    // while we find standardese protocol URLs starting at last_match
-    while (auto match = std::strstr(last_match, link_prefix))
-    {
-        // write from last_match to match
-        output.write_str(last_match, match - last_match);
-
-        // write correct URL
-        auto        entity_name = match + sizeof(link_prefix) - 1;
-        const char* end         = std::strchr(entity_name, '/');
-        if (end == nullptr)
-            end = &document.text.back() + 1;
-
-        auto name = unescape(entity_name, end);
-        auto url  = index_->get_linker().get_url(*index_, nullptr, name, output_extension);
-        if (url.empty())
-        {
-            logger->warn("unable to resolve link to an entity named '{}'", name);
-            output.write_str(match, entity_name - match);
-            last_match = entity_name;
-        }
-        else
-        {
-            output.write_str(url.c_str(), url.size());
-            last_match = end + 1;
-        }
-    }
-    // write remainder of file
-    output.write_str(last_match, &document.text.back() + 1 - last_match);
+    file_output file(prefix_ + document.file_name + '.' + extension);
+    link_output output(logger, *index_, output_extension, file);
+    output.write_str(document.text.c_str(), document.text.size());
+    output.finish();
 }
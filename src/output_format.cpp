@@ -5,7 +5,7 @@
 #include <standardese/output_format.hpp>
 
 #include <cmark.h>
-#include <cstdlib>
+#include <cstring>
 
 #include <standardese/detail/wrapper.hpp>
 #include <standardese/md_entity.hpp>
@@ -22,7 +22,8 @@ namespace
     {
         void operator()(char* str) const STANDARDESE_NOEXCEPT
         {
-            std::free(str);
+            // the rendered string is allocated using the allocator of the nodes
+            detail::get_cmark_mem()->free(str);
         }
     };
 
@@ -30,8 +31,7 @@ namespace
 
     void write(output_stream_base& output, const cmark_str& str)
     {
-        for (auto ptr = str.get(); *ptr; ++ptr)
-            output.write_char(*ptr);
+        output.write_str(str.get(), std::strlen(str.get()));
     }
 }
 
@@ -4,6 +4,8 @@
 
 #include <standardese/output_stream.hpp>
 
+#include <cstring>
+
 using namespace standardese;
 
 output_stream_base::~output_stream_base() STANDARDESE_NOEXCEPT
@@ -12,15 +14,25 @@ output_stream_base::~output_stream_base() STANDARDESE_NOEXCEPT
 
 void output_stream_base::write_str(const char* str, std::size_t n)
 {
-    for (std::size_t i = 0u; i != n; ++i)
-        write_char(str[i]);
+    // write line by line, so that indentation is only needed at the beginning
+    for (auto end = str + n; str != end;)
+    {
+        auto line_end = static_cast<const char*>(std::memchr(str, '\n', std::size_t(end - str)));
+        line_end      = line_end ? line_end + 1 : end;
+
+        do_indent();
+        do_write(str, std::size_t(line_end - str));
+        last_ = line_end[-1];
+
+        str = line_end;
+    }
 }
 
 void output_stream_base::write_char(char c)
 {
     do_indent();
 
-    do_write_char(c);
+    do_write(&c, 1u);
     last_ = c;
 }
 
@@ -53,8 +65,26 @@ void output_stream_base::do_indent()
 {
     if (last_ == '\n')
     {
-        for (auto i = 0u; i != level_; ++i)
-            do_write_char(' ');
+        static const char spaces[] = "                                ";
+        for (auto rest = level_; rest != 0u;)
+        {
+            auto n = rest < sizeof(spaces) - 1u ? rest : unsigned(sizeof(spaces) - 1u);
+            do_write(spaces, n);
+            rest -= n;
+        }
         last_ = ' ';
     }
+}
+
+namespace
+{
+    const std::size_t file_buffer_size = 64u * 1024u;
+}
+
+file_output::file_output(const std::string& file) : buffer_(new char[file_buffer_size])
+{
+    // the buffer has to be set before the file is opened
+    file_.rdbuf()->pubsetbuf(buffer_.get(), std::streamsize(file_buffer_size));
+    file_.open(file);
+    assert(file_.is_open());
 }
\ No newline at end of file
@@ -4,9 +4,14 @@
 
 #include <standardese/parser.hpp>
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
 #include <standardese/detail/tokenizer.hpp>
 #include <standardese/cpp_preprocessor.hpp>
 #include <standardese/error.hpp>
+#include <standardese/preamble_cache.hpp>
 #include <standardese/translation_unit.hpp>
 
 using namespace standardese;
@@ -18,31 +23,31 @@ namespace
         return CXDiagnostic_DisplayOption;
     }
 
-    CXTranslationUnit get_cxunit(const std::shared_ptr<spdlog::logger>& log, CXIndex index,
-                                 const compile_config& c, const char* full_path,
-                                 const std::string& source)
+    std::vector<const char*> get_args(const compile_config& c, const char* full_path)
     {
-        auto args = c.get_flags();
+        auto args = c.get_flags(full_path);
         // allow detection of friend definitions
-        args.push_back("-D__standardese_friend=static");
-
-        CXUnsavedFile file;
-        file.Filename = full_path;
-        file.Contents = source.c_str();
-        file.Length   = source.length();
+        args.push_back("-D__frnd=static");
+        return args;
+    }
 
-        CXTranslationUnit tu;
-        auto              error = clang_parseTranslationUnit2(index, full_path, args.data(),
-                                                 static_cast<int>(args.size()), &file, 1,
-                                                 CXTranslationUnit_Incomplete
+    unsigned get_parse_options(const compile_config& c)
+    {
+        unsigned options =
+            CXTranslationUnit_Incomplete | CXTranslationUnit_DetailedPreprocessingRecord
 #if CINDEX_VERSION_MINOR >= 34
-                                                     | CXTranslationUnit_KeepGoing
+            | CXTranslationUnit_KeepGoing
 #endif
-                                                 ,
-                                                 &tu);
-        if (error != CXError_Success)
-            throw libclang_error(error, "CXTranslationUnit (" + std::string(full_path) + ")");
+            ;
+        if (!c.parse_function_bodies())
+            // the bodies aren't part of the documentation,
+            // get_extent() strips them by looking at the tokens instead
+            options |= CXTranslationUnit_SkipFunctionBodies;
+        return options;
+    }
 
+    void log_diagnostics(const std::shared_ptr<spdlog::logger>& log, CXTranslationUnit tu)
+    {
         auto no_diagnostics = clang_getNumDiagnostics(tu);
         for (auto i = 0u; i != no_diagnostics; ++i)
         {
@@ -57,45 +62,155 @@ namespace
 
             clang_disposeDiagnostic(diag);
         }
+    }
 
+    CXUnsavedFile get_unsaved_file(const char* full_path, const std::string& source)
+    {
+        CXUnsavedFile file;
+        file.Filename = full_path;
+        file.Contents = source.c_str();
+        file.Length   = source.length();
+        return file;
+    }
+
+    CXTranslationUnit get_cxunit(const std::shared_ptr<spdlog::logger>& log, CXIndex index,
+                                 preamble_cache* cache, const compile_config& c,
+                                 const char* full_path, const std::string& source)
+    {
+        auto args = get_args(c, full_path);
+
+        auto pch = cache ? cache->lookup(index, args, source) : "";
+        if (!pch.empty())
+        {
+            args.push_back("-include-pch");
+            args.push_back(pch.c_str());
+        }
+
+        auto              file = get_unsaved_file(full_path, source);
+        CXTranslationUnit tu;
+        auto              error =
+            clang_parseTranslationUnit2(index, full_path, args.data(),
+                                        static_cast<int>(args.size()), &file, 1,
+                                        get_parse_options(c), &tu);
+        if (error != CXError_Success)
+            throw libclang_error(error, "CXTranslationUnit (" + std::string(full_path) + ")");
+
+        log_diagnostics(log, tu);
         return tu;
     }
 
-    std::string replace_friend_definitions(const std::string& preprocessed)
+    // parses the file as it is on disk, it is preprocessed in-process with it
+    // and then reparsed with the result, so every header is only parsed once
+    // the includes are precompiled on the first parse and reused by the reparse
+    CXTranslationUnit get_original_cxunit(CXIndex index, const compile_config& c,
+                                          const char* full_path)
     {
-        std::string output;
+        auto args    = get_args(c, full_path);
+        auto options = get_parse_options(c) | CXTranslationUnit_PrecompiledPreamble
+#if CINDEX_VERSION_MINOR >= 34
+                       | CXTranslationUnit_CreatePreambleOnFirstParse
+#endif
+            ;
 
-        auto last_match = preprocessed.c_str();
-        while (const char* match = std::strstr(last_match, "friend"))
+        CXTranslationUnit tu;
+        auto              error =
+            clang_parseTranslationUnit2(index, full_path, args.data(),
+                                        static_cast<int>(args.size()), nullptr, 0, options, &tu);
+        if (error != CXError_Success)
+            throw libclang_error(error, "CXTranslationUnit (" + std::string(full_path) + ")");
+        return tu;
+    }
+
+    void reparse(const std::shared_ptr<spdlog::logger>& log, CXTranslationUnit tu,
+                 const char* full_path, const std::string& source)
+    {
+        auto file  = get_unsaved_file(full_path, source);
+        auto error = clang_reparseTranslationUnit(tu, 1, &file, clang_defaultReparseOptions(tu));
+        if (error != 0)
+            throw libclang_error(CXErrorCode(error),
+                                 "CXTranslationUnit (" + std::string(full_path) + ")");
+
+        log_diagnostics(log, tu);
+    }
+
+    // friend function definitions are marked by replacing the keyword with a macro
+    // it has the same length, so the source can be modified in place
+    // the macro expands to static, which allows the definition
+    // and is detected by the function parser
+    const char friend_keyword[] = "friend";
+    const char friend_macro[]   = "__frnd";
+    static_assert(sizeof(friend_keyword) == sizeof(friend_macro), "macro must fit the keyword");
+
+    bool is_identifier_char(char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    // returns a pointer to the end of the comment or literal starting at ptr,
+    // or ptr itself if there isn't one
+    const char* skip_comment_or_literal(const char* ptr, const char* begin, const char* end)
+    {
+        if (ptr[0] == '/' && ptr + 1 != end && ptr[1] == '/')
+            return std::find(ptr, end, '\n');
+        else if (ptr[0] == '/' && ptr + 1 != end && ptr[1] == '*')
         {
-            output.append(last_match, match);
+            const char terminator[] = "*/";
+            auto       comment_end  = std::search(ptr + 2, end, terminator, terminator + 2);
+            return comment_end == end ? end : comment_end + 2;
+        }
+        else if (*ptr == '"' || (*ptr == '\'' && (ptr == begin || !is_identifier_char(ptr[-1]))))
+        {
+            // string or character literal, but not a digit separator
+            auto quote = *ptr;
+            for (++ptr; ptr != end && *ptr != quote && *ptr != '\n'; ++ptr)
+                if (*ptr == '\\' && ptr + 1 != end)
+                    ++ptr;
+            return ptr == end ? end : ptr + 1;
+        }
 
-            auto ptr = match;
-            for (auto paren_count = 0; *ptr && *ptr != ';'; ++ptr)
-            {
-                if (*ptr == '(')
-                    ++paren_count;
-                else if (*ptr == ')')
-                    --paren_count;
-                else if (paren_count == 0 && *ptr == '{')
-                    // friend function definition
-                    break;
-            }
+        return ptr;
+    }
 
-            last_match = ptr;
-            if (!*ptr || *ptr == ';')
-                // other friend, keep
-                output.append(match, ptr);
-            else
+    bool is_friend_definition(const char* ptr, const char* end)
+    {
+        for (auto paren_count = 0; ptr != end && *ptr != ';'; ++ptr)
+        {
+            if (*ptr == '(')
+                ++paren_count;
+            else if (*ptr == ')')
+                --paren_count;
+            else if (paren_count == 0 && *ptr == '{')
+                return true;
+        }
+        return false;
+    }
+
+    void mark_friend_definitions(std::string& source)
+    {
+        auto begin = &source[0];
+        auto end   = begin + source.size();
+        for (auto ptr = begin; ptr != end;)
+        {
+            auto next = skip_comment_or_literal(ptr, begin, end);
+            if (next != ptr)
+                ptr += next - ptr;
+            else if (is_identifier_char(*ptr))
             {
-                // friend function definition, replace keyword
-                output += "__standardese_friend";
-                match += std::strlen("friend");
-                output.append(match, ptr);
+                auto identifier_end = std::find_if(ptr, end, [](char c) {
+                    return !is_identifier_char(c);
+                });
+
+                auto length = std::size_t(identifier_end - ptr);
+                if (length == sizeof(friend_keyword) - 1u
+                    && std::strncmp(ptr, friend_keyword, length) == 0
+                    && is_friend_definition(identifier_end, end))
+                    std::memcpy(ptr, friend_macro, length);
+
+                ptr = identifier_end;
             }
+            else
+                ++ptr;
         }
-        output.append(last_match, &preprocessed.back() + 1);
-        return output;
     }
 }
 
@@ -108,14 +223,41 @@ translation_unit parser::parse(const char* full_path, const compile_config& c,
     auto              file_ptr = file.get();
     files_.add_file(std::move(file));
 
-    auto preprocessed = preprocessor_.preprocess(*this, c, full_path, *file_ptr);
-    auto tu =
-        get_cxunit(logger_, index_.get(), c, full_path, replace_friend_definitions(preprocessed));
-    parse_comments(*this, file_name, preprocessed);
+    // all entities of the file are allocated in its arena
+    detail::memory_arena_scope arena_scope(detail::arena_kind::cpp_entity, &file_ptr->arena_);
 
-    file_ptr->wrapper_ = detail::tu_wrapper(tu);
+    CXTranslationUnit  tu = nullptr;
+    detail::tu_wrapper wrapper;
+    // the preamble cache needs the includes normalized by a separate preprocessing,
+    // the external preprocessor doesn't need a translation unit at all
+    if (!c.use_external_preprocessor() && !preamble_cache_)
+    {
+        tu      = get_original_cxunit(index_.get(), c, full_path);
+        wrapper = detail::tu_wrapper(tu);
+    }
+
+    // the source is shared by libclang and the comment parser
+    auto source = preprocessor_.preprocess(*this, c, full_path, *file_ptr, tu);
+    mark_friend_definitions(source);
+
+    if (tu)
+        reparse(logger_, tu, full_path, source);
+    else
+    {
+        tu      = get_cxunit(logger_, index_.get(), preamble_cache_.get(), c, full_path, source);
+        wrapper = detail::tu_wrapper(tu);
+    }
+    parse_comments(*this, file_name, source);
+
+    file_ptr->wrapper_ = std::move(wrapper);
     file_ptr->set_cursor(clang_getTranslationUnitCursor(tu));
 
+    // tokenize the file once, the entities use ranges of it
+    auto cx_file = clang_getFile(tu, full_path);
+    auto range   = clang_getRange(clang_getLocationForOffset(tu, cx_file, 0u),
+                                clang_getLocationForOffset(tu, cx_file, unsigned(source.size())));
+    file_ptr->tokens_.reset(new detail::token_buffer(tu, range));
+
     return translation_unit(*this, full_path, file_ptr);
 }
 
@@ -128,6 +270,11 @@ parser::~parser() STANDARDESE_NOEXCEPT
 {
 }
 
+void parser::enable_preamble_cache(std::string directory)
+{
+    preamble_cache_.reset(new preamble_cache(std::move(directory)));
+}
+
 void parser::deleter::operator()(CXIndex idx) const STANDARDESE_NOEXCEPT
 {
     clang_disposeIndex(idx);
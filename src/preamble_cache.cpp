@@ -0,0 +1,218 @@
+// Copyright (C) 2016 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <standardese/preamble_cache.hpp>
+
+#include <cctype>
+#include <cstring>
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
+#include <standardese/translation_unit.hpp>
+
+using namespace standardese;
+
+namespace fs = boost::filesystem;
+
+struct preamble_cache::entry
+{
+    std::mutex  mutex;
+    std::string path;
+    std::size_t id;
+    unsigned    use_count;
+    bool        failed;
+
+    explicit entry(std::size_t id) : id(id), use_count(0u), failed(false)
+    {
+    }
+};
+
+preamble_cache::preamble_cache(std::string directory)
+: directory_(std::move(directory)), hits_(0u), misses_(0u)
+{
+    fs::create_directories(directory_);
+}
+
+preamble_cache::~preamble_cache() STANDARDESE_NOEXCEPT
+{
+    boost::system::error_code ec;
+    for (auto& e : entries_)
+        if (!e.second->path.empty())
+        {
+            fs::remove(e.second->path, ec);
+            fs::remove(e.second->path + ".hpp", ec);
+        }
+    // only removed if empty
+    fs::remove(directory_, ec);
+}
+
+namespace
+{
+    const char* guard_suffixes[] = {"_H", "_H_", "_HPP", "_HPP_", "_HXX", "_INCLUDED"};
+
+    // heuristic to allow include guards before the includes
+    bool is_guard_definition(const std::string& line)
+    {
+        if (line.compare(0, 8, "#define ") != 0)
+            return false;
+
+        auto name = line.substr(8);
+        for (auto c : name)
+            if (!std::isalnum(c) && c != '_')
+                // not just a name
+                return false;
+
+        for (auto suffix : guard_suffixes)
+        {
+            auto length = std::strlen(suffix);
+            if (name.size() > length
+                && name.compare(name.size() - length, length, suffix) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    // returns the inclusion directives at the beginning of the preprocessed source
+    std::string get_preamble(const std::string& source)
+    {
+        std::string result;
+
+        auto in_comment = false;
+        for (auto ptr = source.c_str(); *ptr;)
+        {
+            auto end = std::strchr(ptr, '\n');
+            if (!end)
+                end = ptr + std::strlen(ptr);
+
+            std::string line(ptr, end);
+            ptr = *end ? end + 1 : end;
+
+            while (!line.empty() && std::isspace(line.back()))
+                line.pop_back();
+            auto first = line.find_first_not_of(" \t");
+            line.erase(0, first == std::string::npos ? line.size() : first);
+
+            if (in_comment || line.compare(0, 2, "/*") == 0)
+            {
+                auto comment_end = line.find("*/");
+                if (comment_end == std::string::npos)
+                    in_comment = true;
+                else if (comment_end + 2u == line.size())
+                    in_comment = false;
+                else
+                    // code after comment
+                    break;
+            }
+            else if (line.empty() || line.compare(0, 2, "//") == 0 || line == "#pragma once"
+                     || is_guard_definition(line))
+                continue;
+            else if (line.compare(0, 9, "#include ") == 0)
+            {
+                result += line;
+                result += '\n';
+            }
+            else
+                break;
+        }
+
+        return result;
+    }
+
+    bool has_errors(CXTranslationUnit tu)
+    {
+        auto no_diagnostics = clang_getNumDiagnostics(tu);
+        for (auto i = 0u; i != no_diagnostics; ++i)
+        {
+            auto diag  = clang_getDiagnostic(tu, i);
+            auto error = clang_getDiagnosticSeverity(diag) >= CXDiagnostic_Error;
+            clang_disposeDiagnostic(diag);
+
+            if (error)
+                return true;
+        }
+        return false;
+    }
+
+    bool precompile(CXIndex index, const std::vector<const char*>& args,
+                    const std::string& preamble, const std::string& path)
+    {
+        // header must exist, it is checked when the precompiled header is used
+        auto header = path + ".hpp";
+        {
+            std::ofstream file(header);
+            if (!(file << preamble))
+                return false;
+        }
+
+        CXTranslationUnit tu;
+        auto              error =
+            clang_parseTranslationUnit2(index, header.c_str(), args.data(),
+                                        static_cast<int>(args.size()), nullptr, 0,
+                                        CXTranslationUnit_Incomplete
+                                            | CXTranslationUnit_ForSerialization
+                                            | CXTranslationUnit_DetailedPreprocessingRecord,
+                                        &tu);
+        if (error != CXError_Success)
+            return false;
+
+        detail::tu_wrapper wrapper(tu);
+        return !has_errors(tu)
+               && clang_saveTranslationUnit(tu, path.c_str(), clang_defaultSaveOptions(tu))
+                      == CXSaveError_None;
+    }
+}
+
+std::string preamble_cache::lookup(CXIndex index, const std::vector<const char*>& args,
+                                   const std::string& source)
+{
+    auto preamble = get_preamble(source);
+    if (preamble.empty())
+        return "";
+
+    // precompiled header can only be used with the same flags
+    auto key = preamble;
+    for (auto arg : args)
+    {
+        key += '\0';
+        key += arg;
+    }
+
+    std::shared_ptr<entry> e;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto&                       ptr = entries_[key];
+        if (!ptr)
+            ptr = std::make_shared<entry>(entries_.size());
+        e = ptr;
+    }
+
+    // other files with the same preamble wait until it is precompiled
+    std::lock_guard<std::mutex> lock(e->mutex);
+    if (++e->use_count == 1u || e->failed)
+    {
+        // first file with that preamble isn't worth it
+        ++misses_;
+        return "";
+    }
+    else if (e->path.empty())
+    {
+        auto path = (fs::path(directory_) / ("preamble-" + std::to_string(e->id) + ".pch"))
+                        .generic_string();
+        if (!precompile(index, args, preamble, path))
+        {
+            boost::system::error_code ec;
+            fs::remove(path, ec);
+            fs::remove(path + ".hpp", ec);
+
+            e->failed = true;
+            ++misses_;
+            return "";
+        }
+        e->path = std::move(path);
+    }
+
+    ++hits_;
+    return e->path;
+}
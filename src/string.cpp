@@ -0,0 +1,99 @@
+// Copyright (C) 2016 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <standardese/string.hpp>
+
+#include <memory>
+
+#include <standardese/detail/memory_arena.hpp>
+
+using namespace standardese;
+
+namespace
+{
+    std::size_t hash_string(const char* str, std::size_t length) STANDARDESE_NOEXCEPT
+    {
+        // FNV-1a
+        std::size_t result = 2166136261u;
+        for (auto end = str + length; str != end; ++str)
+        {
+            result ^= static_cast<unsigned char>(*str);
+            result *= 16777619u;
+        }
+        return result;
+    }
+
+    // append-only, the nodes are never freed,
+    // so that interned strings can be used during static destruction
+    class string_pool
+    {
+    public:
+        string_pool() STANDARDESE_NOEXCEPT
+        {
+            for (auto& shard : shards_)
+                shard.store(nullptr, std::memory_order_relaxed);
+        }
+
+        string_pool(const string_pool&) = delete;
+        string_pool& operator=(const string_pool&) = delete;
+
+        const detail::interned_node& intern(const char* str, std::size_t length)
+        {
+            auto hash = hash_string(str, length);
+
+            std::unique_ptr<detail::interned_node> new_node;
+            for (auto cur = &shards_[hash % no_shards];;)
+            {
+                auto node = cur->load(std::memory_order_acquire);
+                if (!node)
+                {
+                    // append at the end, readers either see the old or the new list
+                    if (!new_node)
+                        new_node.reset(new detail::interned_node(str, length, hash));
+                    if (cur->compare_exchange_strong(node, new_node.get(),
+                                                     std::memory_order_release,
+                                                     std::memory_order_acquire))
+                        return *new_node.release();
+                    // someone else appended, check their node
+                }
+
+                if (node->hash == hash && node->str.length() == length
+                    && std::memcmp(node->str.c_str(), str, length) == 0)
+                    return *node;
+                cur = &node->next;
+            }
+        }
+
+    private:
+        static const std::size_t no_shards = 1024u;
+
+        std::atomic<detail::interned_node*> shards_[no_shards];
+    };
+
+    string_pool& get_pool()
+    {
+        static string_pool pool;
+        return pool;
+    }
+}
+
+interned_string::interned_string(const char* str, std::size_t length)
+: node_(&get_pool().intern(str, length))
+{
+}
+
+char* string::allocate_in_arena(std::size_t length) const
+{
+    // short strings don't allocate anyway, putting them into the arena would only waste memory
+    static const auto small_capacity = std::string().capacity();
+    if (length <= small_capacity)
+        return nullptr;
+
+    // the entity was allocated in the arena just before its members are initialized,
+    // so it is in the current block unless a previous member filled it up
+    auto arena = detail::memory_arena::get_current(detail::arena_kind::cpp_entity);
+    if (!arena || !arena->in_current_block(this))
+        return nullptr;
+    return static_cast<char*>(arena->allocate(length + 1u, 1u));
+}
@@ -5,9 +5,8 @@
 #include <standardese/template_processor.hpp>
 
 #include <algorithm>
+#include <cassert>
 #include <cstring>
-#include <new>
-#include <type_traits>
 #include <vector>
 
 #include <spdlog/fmt/fmt.h>
@@ -88,9 +87,71 @@ template_if_operation template_config::try_get_operation(const std::string& str)
     return static_cast<template_if_operation>(iter - std::begin(if_operations_));
 }
 
+namespace standardese
+{
+    namespace detail
+    {
+        // a variable of the template, bound when the template is parsed
+        struct template_variable
+        {
+            enum kind_t
+            {
+                entity_name,
+                file,
+                loop_variable,
+            };
+
+            std::string name;
+            kind_t      kind;
+            std::size_t loop; // index of the loop that declares it
+
+            template_variable() : kind(entity_name), loop(0u)
+            {
+            }
+        };
+
+        enum class template_op
+        {
+            text,       // writes the text
+            command,    // writes the result of the command
+            loop_begin, // starts the loop over the children of the entity, jumps if there are none
+            loop_end,   // jumps to the beginning of the loop if there is another child
+            branch,     // jumps if the operation is false
+            jump,
+        };
+
+        struct template_instruction
+        {
+            template_op           op;
+            template_command      command;
+            template_if_operation operation;
+            template_variable     entity, argument;
+            std::string           text; // the text or the name of the output format
+            std::size_t           loop, target;
+
+            explicit template_instruction(template_op op)
+            : op(op),
+              command(template_command::invalid),
+              operation(template_if_operation::invalid),
+              loop(0u),
+              target(0u)
+            {
+            }
+        };
+
+        struct template_program
+        {
+            std::vector<template_instruction> instructions;
+            std::size_t                       no_loops = 0u; // maximal nesting depth
+        };
+    } // namespace detail
+} // namespace standardese
+
 namespace
 {
     using standardese::index;
+    using detail::template_op;
+    using detail::template_variable;
 
     std::string read_arg(const char*& ptr, const char* end)
     {
@@ -130,7 +191,7 @@ namespace
                 auto cmd = config.try_get_command(cur_command.c_str() + prefix_length);
                 if (cmd != template_command::invalid)
                     // process command
-                    handle(cmd, start, last, end);
+                    handle(cmd, start, last);
                 else
                     log.warn("unknown template command '{}'", cur_command);
             }
@@ -146,352 +207,273 @@ namespace
         skip(last_match, nullptr);
     }
 
-    class stack
+    // translates the commands into instructions,
+    // blocks become jumps and variables are bound to their loop
+    class template_compiler
     {
     public:
-        stack(const parser& p, const index& idx, const doc_entity* file) STANDARDESE_NOEXCEPT
+        template_compiler(const parser& p, detail::template_program& program) STANDARDESE_NOEXCEPT
             : parser_(&p),
-              idx_(&idx),
-              file_(file)
+              program_(&program),
+              label_(0u)
         {
         }
 
-        std::string& get_buffer() STANDARDESE_NOEXCEPT
+        void add_text(const char* begin, const char* end)
         {
-            if (stack_.empty())
-                return buffer_;
-            else if (auto loop = stack_.back().get_for_loop())
-                return loop->buffer;
-            else if (auto clause = stack_.back().get_if_clause())
-                return clause->buffer;
-            else if (auto clause = stack_.back().get_else_clause())
-                return clause->buffer;
-            assert(false);
-            return buffer_;
-        }
+            auto& instructions = program_->instructions;
+            // text can't be merged into text before a jump target
+            if (instructions.size() <= label_ || instructions.back().op != template_op::text)
+                instructions.emplace_back(template_op::text);
 
-        const doc_entity* try_lookup_var(const std::string& name) const STANDARDESE_NOEXCEPT
-        {
-            auto skip   = false;
-            auto result = find_variable(name, skip);
-            if (skip || result)
-                return result;
-            else if (name == "$file")
-                return file_;
-
-            return idx_->try_lookup(name);
+            if (!end)
+                instructions.back().text += begin;
+            else
+                instructions.back().text.append(begin, end - begin);
         }
 
-        const doc_entity* lookup_var(const std::string& name) const STANDARDESE_NOEXCEPT
+        void add_command(template_command cmd, const char* ptr, const char* last)
         {
-            auto skip   = false;
-            auto result = find_variable(name, skip);
-            if (skip || result)
-                return result;
-            else if (file_ && name == "$file")
-                return file_;
+            switch (cmd)
+            {
+            case template_command::generate_doc:
+            case template_command::generate_synopsis:
+            case template_command::generate_doc_text:
+            case template_command::generate_anchor:
+            case template_command::name:
+            case template_command::unique_name:
+            case template_command::index_name:
+            case template_command::module:
+            {
+                auto& instr   = add(template_op::command);
+                instr.command = cmd;
+                instr.entity  = bind(read_arg(ptr, last));
+                instr.text    = read_arg(ptr, last);
+                break;
+            }
 
-            auto entity = idx_->try_lookup(name);
-            if (!entity)
-                parser_->get_logger()->warn("unable to find entity named '{}'", name);
-            return entity;
-        }
+            case template_command::for_each:
+            {
+                auto var_name = read_arg(ptr, last);
 
-        void push_loop(const doc_entity& e, std::string loop_var, const char* ptr)
-        {
-            stack_.emplace_back(for_loop(e, std::move(loop_var), ptr));
-        }
+                auto& instr  = add(template_op::loop_begin);
+                instr.entity = bind(read_arg(ptr, last));
+                instr.loop   = loop_vars_.size();
 
-        void push_if(bool v)
-        {
-            stack_.emplace_back(if_clause(v));
-        }
+                blocks_.emplace_back(true, program_->instructions.size() - 1u);
+                loop_vars_.push_back(std::move(var_name));
+                program_->no_loops = std::max(program_->no_loops, loop_vars_.size());
+                break;
+            }
+            case template_command::if_clause:
+                blocks_.emplace_back(false, 0u);
+                add_branch(ptr, last);
+                break;
+            case template_command::else_if_clause:
+                if (!in_if())
+                {
+                    // treat it as a regular if
+                    parser_->get_logger()->warn("else block without if");
+                    blocks_.emplace_back(false, 0u);
+                }
+                else
+                    end_clause();
+                add_branch(ptr, last);
+                break;
+            case template_command::else_clause:
+                if (!in_if())
+                    parser_->get_logger()->warn("else block without if");
+                else
+                {
+                    end_clause();
+                    blocks_.back().branch = block::no_branch;
+                }
+                break;
+            case template_command::end:
+                if (blocks_.empty())
+                    parser_->get_logger()->warn("end block without active block");
+                else
+                    end_block();
+                break;
 
-        void on_end(const char*& ptr)
-        {
-            if (stack_.empty())
-                parser_->get_logger()->warn("end block without active block");
-            else if (auto loop = stack_.back().get_for_loop())
-                end_loop(ptr, loop);
-            else if (auto clause = stack_.back().get_if_clause())
-                end_if(clause);
-            else if (auto clause = stack_.back().get_else_clause())
-                end_else(clause);
-            else
+            case template_command::invalid:
                 assert(false);
-        }
-
-        void on_else(bool else_if)
-        {
-            if (stack_.empty() || stack_.back().get_type() != if_clause_t)
-                parser_->get_logger()->warn("else block without if");
-            else if (auto clause = stack_.back().get_if_clause())
-            {
-                auto value = end_if(clause);
-                stack_.emplace_back(else_clause(!value, else_if));
             }
         }
 
-        const parser& get_parser() const STANDARDESE_NOEXCEPT
+        void finish()
         {
-            return *parser_;
+            if (!blocks_.empty())
+                parser_->get_logger()->warn("block without end");
+            while (!blocks_.empty())
+                end_block();
         }
 
     private:
-        struct for_loop
+        struct block
         {
-            std::string                          loop_var, buffer;
-            doc_entity_container::const_iterator cur;
-            doc_entity_container::const_iterator end;
-            const char*                          start;
+            static const std::size_t no_branch = std::size_t(-1);
 
-            explicit for_loop(const doc_entity& e, std::string var, const char* start)
-            : loop_var(std::move(var)), cur(e.begin()), end(e.end()), start(start)
+            std::vector<std::size_t> jumps;  // jumps to the end of an if
+            std::size_t              begin;  // instruction that starts the loop
+            std::size_t              branch; // branch of the current if clause
+            bool                     loop;
+
+            block(bool loop, std::size_t begin)
+            : begin(begin), branch(no_branch), loop(loop)
             {
             }
         };
 
-        const doc_entity* find_variable(const std::string& name, bool& skip) const
+        detail::template_instruction& add(template_op op)
         {
-            for (auto iter = stack_.rbegin(); iter != stack_.rend(); ++iter)
-            {
-                if (auto loop = iter->get_for_loop())
-                {
-                    if (loop->cur == loop->end)
-                    {
-                        // inside a loop that is skipped
-                        skip = true;
-                        return nullptr;
-                    }
-                    else if (loop->loop_var == name)
-                        return &*loop->cur;
-                }
-            }
-
-            return nullptr;
+            program_->instructions.emplace_back(op);
+            return program_->instructions.back();
         }
 
-        void end_loop(const char*& ptr, for_loop* loop)
+        template_variable bind(std::string name) const
         {
-            if (loop->cur == loop->end)
-                // loop is skipped, just ignore
-                stack_.pop_back();
-            else if (std::next(loop->cur) != loop->end)
-            {
-                // next iteration
-                ++loop->cur;
-                ptr = loop->start;
-            }
-            else
+            template_variable result;
+
+            auto iter = std::find(loop_vars_.rbegin(), loop_vars_.rend(), name);
+            if (iter != loop_vars_.rend())
             {
-                // finish loop
-                auto res = std::move(loop->buffer);
-                stack_.pop_back();
-                get_buffer() += std::move(res);
+                result.kind = template_variable::loop_variable;
+                result.loop = std::size_t(loop_vars_.rend() - iter - 1);
             }
+            else if (name == "$file")
+                result.kind = template_variable::file;
+
+            result.name = std::move(name);
+            return result;
         }
 
-        struct if_clause
+        bool in_if() const STANDARDESE_NOEXCEPT
         {
-            std::string buffer;
-            bool        value;
-
-            explicit if_clause(bool v) : value(v)
-            {
-            }
-        };
+            return !blocks_.empty() && !blocks_.back().loop
+                   && blocks_.back().branch != block::no_branch;
+        }
 
-        // returns true if any if was chosen
-        bool end_if(if_clause* clause)
+        void add_branch(const char* ptr, const char* last)
         {
-            auto value = clause->value;
+            auto& instr  = add(template_op::branch);
+            instr.entity = bind(read_arg(ptr, last));
 
-            if (clause->value)
-            {
-                // take if clause
-                auto res = std::move(clause->buffer);
-                stack_.pop_back();
-                get_buffer() += std::move(res);
-            }
-            else
-            {
-                // skip if clause
-                stack_.pop_back();
-            }
-
-            if (!stack_.empty() && stack_.back().get_type() == else_clause_t)
-            {
-                auto clause = stack_.back().get_else_clause();
-                if (clause->owns_if)
-                {
-                    // pop else clause as well
-                    value = value || !clause->value;
-                    end_else(clause);
-                }
-            }
+            auto op         = read_arg(ptr, last);
+            instr.operation = parser_->get_template_config().try_get_operation(op);
+            if (instr.operation == template_if_operation::invalid)
+                parser_->get_logger()->warn("unknown if operation '{}'", op);
+            instr.argument = bind(read_arg(ptr, last));
 
-            return value;
+            blocks_.back().branch = program_->instructions.size() - 1u;
         }
 
-        struct else_clause
+        // jumps over the remaining clauses of the if
+        void end_clause()
         {
-            std::string buffer;
-            bool        value;
-            bool        owns_if; // true if it shares an end with if
+            add(template_op::jump);
 
-            explicit else_clause(bool v, bool owns) : value(v), owns_if(owns)
-            {
-            }
-        };
+            auto& b = blocks_.back();
+            b.jumps.push_back(program_->instructions.size() - 1u);
+            program_->instructions[b.branch].target = label_ = program_->instructions.size();
+        }
 
-        void end_else(else_clause* clause)
+        void end_block()
         {
-            if (clause->value)
+            auto& instructions = program_->instructions;
+            auto& b            = blocks_.back();
+            if (b.loop)
             {
-                // take else
-                auto res = std::move(clause->buffer);
-                stack_.pop_back();
-                get_buffer() += std::move(res);
+                auto& instr  = add(template_op::loop_end);
+                instr.loop   = instructions[b.begin].loop;
+                instr.target = b.begin + 1u;
+
+                instructions[b.begin].target = instructions.size();
+                loop_vars_.pop_back();
             }
             else
             {
-                // skip else
-                stack_.pop_back();
+                if (b.branch != block::no_branch)
+                    instructions[b.branch].target = instructions.size();
+                for (auto jump : b.jumps)
+                    instructions[jump].target = instructions.size();
             }
+            label_ = instructions.size();
+            blocks_.pop_back();
         }
 
-        enum state_type
-        {
-            for_loop_t,
-            if_clause_t,
-            else_clause_t,
-        };
+        std::vector<block>        blocks_;
+        std::vector<std::string>  loop_vars_;
+        const parser*             parser_;
+        detail::template_program* program_;
+        std::size_t               label_; // the last jump target
+    };
 
-        class state
+    class template_state
+    {
+    public:
+        template_state(const parser& p, const index& idx, const doc_entity* file,
+                       std::size_t no_loops)
+        : loops_(no_loops), parser_(&p), idx_(&idx), file_(file)
         {
-        public:
-            state(for_loop loop) : type_(for_loop_t)
-            {
-                ::new (as_void()) for_loop(std::move(loop));
-            }
-
-            state(if_clause c) : type_(if_clause_t)
-            {
-                ::new (as_void()) if_clause(std::move(c));
-            }
-
-            state(else_clause c) : type_(else_clause_t)
-            {
-                ::new (as_void()) else_clause(std::move(c));
-            }
-
-            state(state&& other) STANDARDESE_NOEXCEPT : type_(other.type_)
-            {
-                switch (other.type_)
-                {
-                case for_loop_t:
-                    ::new (as_void()) for_loop(std::move(*other.get_for_loop()));
-                    break;
-                case if_clause_t:
-                    ::new (as_void()) if_clause(std::move(*other.get_if_clause()));
-                    break;
-                case else_clause_t:
-                    ::new (as_void()) else_clause(std::move(*other.get_else_clause()));
-                    break;
-                }
-            }
-
-            ~state() STANDARDESE_NOEXCEPT
-            {
-                switch (type_)
-                {
-                case for_loop_t:
-                    get_for_loop()->~for_loop();
-                    break;
-                case if_clause_t:
-                    get_if_clause()->~if_clause();
-                    break;
-                case else_clause_t:
-                    get_else_clause()->~else_clause();
-                    break;
-                }
-            }
-
-            state& operator=(state&&) STANDARDESE_NOEXCEPT = delete;
-
-            state_type get_type() const STANDARDESE_NOEXCEPT
-            {
-                return type_;
-            }
-
-            for_loop* get_for_loop() STANDARDESE_NOEXCEPT
-            {
-                return type_ == for_loop_t ? static_cast<for_loop*>(as_void()) : nullptr;
-            }
-
-            const for_loop* get_for_loop() const STANDARDESE_NOEXCEPT
-            {
-                return type_ == for_loop_t ? static_cast<const for_loop*>(as_void()) : nullptr;
-            }
-
-            if_clause* get_if_clause() STANDARDESE_NOEXCEPT
-            {
-                return type_ == if_clause_t ? static_cast<if_clause*>(as_void()) : nullptr;
-            }
+        }
 
-            const if_clause* get_if_clause() const STANDARDESE_NOEXCEPT
-            {
-                return type_ == if_clause_t ? static_cast<const if_clause*>(as_void()) : nullptr;
-            }
+        const doc_entity* try_lookup_var(const template_variable& var) const STANDARDESE_NOEXCEPT
+        {
+            if (var.kind == template_variable::loop_variable)
+                return &*loops_[var.loop].cur;
+            else if (file_ && var.kind == template_variable::file)
+                return file_;
 
-            else_clause* get_else_clause() STANDARDESE_NOEXCEPT
-            {
-                return type_ == else_clause_t ? static_cast<else_clause*>(as_void()) : nullptr;
-            }
+            return idx_->try_lookup(var.name);
+        }
 
-            const else_clause* get_else_clause() const STANDARDESE_NOEXCEPT
-            {
-                return type_ == else_clause_t ? static_cast<const else_clause*>(as_void()) :
-                                                nullptr;
-            }
+        const doc_entity* lookup_var(const template_variable& var) const STANDARDESE_NOEXCEPT
+        {
+            auto entity = try_lookup_var(var);
+            if (!entity)
+                parser_->get_logger()->warn("unable to find entity named '{}'", var.name);
+            return entity;
+        }
 
-        private:
-            void* as_void() STANDARDESE_NOEXCEPT
-            {
-                return &storage_;
-            }
+        // returns false if the entity doesn't have children
+        bool begin_loop(std::size_t loop, const doc_entity& e) STANDARDESE_NOEXCEPT
+        {
+            loops_[loop].cur = e.begin();
+            loops_[loop].end = e.end();
+            return loops_[loop].cur != loops_[loop].end;
+        }
 
-            const void* as_void() const STANDARDESE_NOEXCEPT
-            {
-                return &storage_;
-            }
+        // returns false if there is no next child
+        bool next_iteration(std::size_t loop) STANDARDESE_NOEXCEPT
+        {
+            return ++loops_[loop].cur != loops_[loop].end;
+        }
 
-            union storage_helper {
-                for_loop    l;
-                if_clause   c;
-                else_clause e;
-            };
+        const parser& get_parser() const STANDARDESE_NOEXCEPT
+        {
+            return *parser_;
+        }
 
-            using storage = typename std::aligned_storage<sizeof(storage_helper),
-                                                          alignof(storage_helper)>::type;
-            storage    storage_;
-            state_type type_;
+    private:
+        struct loop_state
+        {
+            doc_entity_container::const_iterator cur, end;
         };
 
-        std::vector<state> stack_;
-        std::string        buffer_;
-        const parser*      parser_;
-        const index*       idx_;
-        const doc_entity*  file_;
+        std::vector<loop_state> loops_;
+        const parser*           parser_;
+        const index*            idx_;
+        const doc_entity*       file_;
     };
 
-    md_ptr<md_document> get_documentation(const stack& vars, const documentation* doc,
-                                          const index& i, const std::string& name)
+    md_ptr<md_document> get_documentation(const template_state& vars, const documentation* doc,
+                                          const index& i, const template_variable& var)
     {
-        if (doc && doc->document && name == "$file")
+        if (doc && doc->document && var.kind == template_variable::file)
             return doc->document->clone();
 
-        auto entity = vars.lookup_var(name);
+        auto entity = vars.lookup_var(var);
         if (!entity)
             return nullptr;
 
@@ -500,9 +482,9 @@ namespace
         return document;
     }
 
-    md_ptr<md_document> get_synopsis(const stack& vars, const std::string& name)
+    md_ptr<md_document> get_synopsis(const template_state& vars, const template_variable& var)
     {
-        auto entity = vars.lookup_var(name);
+        auto entity = vars.lookup_var(var);
         if (!entity)
             return nullptr;
 
@@ -514,9 +496,10 @@ namespace
         return doc;
     }
 
-    md_ptr<md_document> get_documentation_text(const stack& vars, const std::string& name)
+    md_ptr<md_document> get_documentation_text(const template_state&    vars,
+                                               const template_variable& var)
     {
-        auto entity = vars.lookup_var(name);
+        auto entity = vars.lookup_var(var);
         if (!entity)
             return nullptr;
 
@@ -525,14 +508,14 @@ namespace
         return doc;
     }
 
-    md_ptr<md_document> get_anchor(const stack& vars, const linker& l,
-                                   const std::string& output_file, const std::string& name)
+    md_ptr<md_document> get_anchor(const template_state& vars, const linker& l,
+                                   const std::string& output_file, const template_variable& var)
     {
         auto doc = md_document::make("");
         doc->add_entity(md_paragraph::make(*doc));
         auto& paragraph = static_cast<md_container&>(doc->back());
 
-        if (auto entity = vars.try_lookup_var(name))
+        if (auto entity = vars.try_lookup_var(var))
         {
             // notify linker that entity is now documented here
             l.change_output_file(*entity, output_file);
@@ -541,17 +524,17 @@ namespace
         else
         {
             // register anchor
-            auto id = l.register_anchor(name, output_file);
+            auto id = l.register_anchor(var.name, output_file);
             paragraph.add_entity(md_anchor::make(paragraph, id.c_str()));
         }
 
         return doc;
     }
 
-    std::string write_document(const parser& p, const index& idx, md_ptr<md_document> doc,
-                               output_format_base* default_format, const std::string& format_name)
+    void write_document(output_stream_base& output, const parser& p, const index& idx,
+                        md_ptr<md_document> doc, output_format_base* default_format,
+                        const std::string& format_name)
     {
-        string_output output;
         normalize_urls(idx, *doc);
 
         std::unique_ptr<output_format_base> format;
@@ -564,28 +547,27 @@ namespace
         if (!default_format)
         {
             p.get_logger()->warn("invalid format name '{}'", format_name);
-            return "";
+            return;
         }
 
         default_format->render(output, *doc);
-        return output.get_string();
     }
 
-    bool get_if_value(const stack& s, const template_config& config, const doc_entity* entity,
-                      const char*& ptr, const char* last)
+    void write_str(output_stream_base& output, const char* str)
+    {
+        output.write_str(str, std::strlen(str));
+    }
+
+    bool get_if_value(const template_state& s, const detail::template_instruction& instr,
+                      const doc_entity* entity)
     {
-        auto op = read_arg(ptr, last);
-        switch (config.get_operation(op))
+        switch (instr.operation)
         {
         case template_if_operation::name:
-        {
-            auto name = read_arg(ptr, last);
-            return entity->get_unique_name() == name.c_str();
-        }
+            return entity->get_unique_name() == instr.argument.name.c_str();
         case template_if_operation::first_child:
         {
-            auto name  = read_arg(ptr, last);
-            auto other = s.lookup_var(name);
+            auto other = s.lookup_var(instr.argument);
             if (!other || other->begin() == other->end())
                 return false;
             return entity == &*other->begin();
@@ -600,111 +582,141 @@ namespace
         case template_if_operation::index:
             return entity->get_entity_type() == doc_entity::index_t;
         case template_if_operation::invalid:
-            s.get_parser().get_logger()->warn("unknown if operation '{}'", op);
+            // already reported
             break;
         }
 
         return false;
     }
-}
 
-raw_document standardese::process_template(const parser& p, const index& i,
-                                           const template_file& input,
-                                           output_format_base*  default_format,
-                                           const documentation* doc_file)
-{
-    stack s(p, i, doc_file ? doc_file->file.get() : nullptr);
-    auto handle = [&](template_command cur_command, const char* ptr, const char* last,
-                      const char*& end) {
-        switch (cur_command)
+    void execute_command(output_stream_base& output, const template_state& s, const index& i,
+                         const detail::template_instruction& instr, const std::string& output_name,
+                         output_format_base* default_format, const documentation* doc_file)
+    {
+        auto& p = s.get_parser();
+        switch (instr.command)
         {
         case template_command::generate_doc:
-            if (auto doc = get_documentation(s, doc_file, i, read_arg(ptr, last)))
-                s.get_buffer() +=
-                    write_document(p, i, std::move(doc), default_format, read_arg(ptr, last));
+            if (auto doc = get_documentation(s, doc_file, i, instr.entity))
+                write_document(output, p, i, std::move(doc), default_format, instr.text);
             break;
         case template_command::generate_synopsis:
-            if (auto doc = get_synopsis(s, read_arg(ptr, last)))
-                s.get_buffer() +=
-                    write_document(p, i, std::move(doc), default_format, read_arg(ptr, last));
+            if (auto doc = get_synopsis(s, instr.entity))
+                write_document(output, p, i, std::move(doc), default_format, instr.text);
             break;
         case template_command::generate_doc_text:
-            if (auto doc = get_documentation_text(s, read_arg(ptr, last)))
-                s.get_buffer() +=
-                    write_document(p, i, std::move(doc), default_format, read_arg(ptr, last));
+            if (auto doc = get_documentation_text(s, instr.entity))
+                write_document(output, p, i, std::move(doc), default_format, instr.text);
             break;
         case template_command::generate_anchor:
-            if (auto doc = get_anchor(s, i.get_linker(), input.output_name, read_arg(ptr, last)))
-                s.get_buffer() +=
-                    write_document(p, i, std::move(doc), default_format, read_arg(ptr, last));
+            if (auto doc = get_anchor(s, i.get_linker(), output_name, instr.entity))
+                write_document(output, p, i, std::move(doc), default_format, instr.text);
             break;
 
         case template_command::name:
-        {
-            auto entity = s.lookup_var(read_arg(ptr, last));
-            if (entity)
-                s.get_buffer() += entity->get_name().c_str();
+            if (auto entity = s.lookup_var(instr.entity))
+                write_str(output, entity->get_name().c_str());
             break;
-        }
         case template_command::unique_name:
-        {
-            auto entity = s.lookup_var(read_arg(ptr, last));
-            if (entity)
-                s.get_buffer() += entity->get_unique_name().c_str();
+            if (auto entity = s.lookup_var(instr.entity))
+                write_str(output, entity->get_unique_name().c_str());
             break;
-        }
         case template_command::index_name:
-        {
-            auto entity = s.lookup_var(read_arg(ptr, last));
-            if (entity)
-                s.get_buffer() += entity->get_index_name(true).c_str();
+            if (auto entity = s.lookup_var(instr.entity))
+                write_str(output, entity->get_index_name(true).c_str());
             break;
-        }
         case template_command::module:
-        {
-            auto entity = s.lookup_var(read_arg(ptr, last));
-            if (entity)
-                s.get_buffer() += entity->get_module();
+            if (auto entity = s.lookup_var(instr.entity))
+                output.write_str(entity->get_module().c_str(), entity->get_module().size());
+            break;
+
+        default:
+            assert(false);
             break;
         }
+    }
+}
+
+compiled_template::compiled_template(const parser& p, const template_file& input)
+: output_name_(input.output_name), program_(new detail::template_program)
+{
+    template_compiler compiler(p, *program_);
+    parse_commands(*p.get_logger(), p.get_template_config(), input.text.c_str(),
+                   [&](template_command cmd, const char* ptr, const char* last) {
+                       compiler.add_command(cmd, ptr, last);
+                   },
+                   [&](const char* begin, const char* end) { compiler.add_text(begin, end); });
+    compiler.finish();
+}
+
+compiled_template::compiled_template(compiled_template&& other) STANDARDESE_NOEXCEPT = default;
+
+compiled_template::~compiled_template() STANDARDESE_NOEXCEPT = default;
+
+compiled_template& compiled_template::operator=(compiled_template&& other)
+    STANDARDESE_NOEXCEPT = default;
+
+void standardese::process_template(output_stream_base& output, const parser& p, const index& i,
+                                   const compiled_template& templ,
+                                   output_format_base*      default_format,
+                                   const documentation*     doc_file)
+{
+    auto& program = templ.get_program();
 
-        case template_command::for_each:
+    template_state s(p, i, doc_file ? doc_file->file.get() : nullptr, program.no_loops);
+    for (std::size_t ip = 0u; ip != program.instructions.size();)
+    {
+        auto& instr = program.instructions[ip++];
+        switch (instr.op)
         {
-            auto var_name = read_arg(ptr, last);
-            auto entity   = s.lookup_var(read_arg(ptr, last));
-            if (!entity)
-                break;
-            s.push_loop(*entity, var_name, end);
+        case template_op::text:
+            output.write_str(instr.text.c_str(), instr.text.size());
             break;
-        }
-        case template_command::else_if_clause:
-            // add an else_if else, then regular if
-            s.on_else(true);
-        case template_command::if_clause:
+        case template_op::command:
+            execute_command(output, s, i, instr, templ.get_output_name(), default_format,
+                            doc_file);
+            break;
+
+        case template_op::loop_begin:
         {
-            auto entity = s.lookup_var(read_arg(ptr, last));
-            if (!entity)
-                break;
-            s.push_if(get_if_value(s, p.get_template_config(), entity, ptr, last));
+            auto entity = s.lookup_var(instr.entity);
+            if (!entity || !s.begin_loop(instr.loop, *entity))
+                ip = instr.target;
             break;
         }
-        case template_command::else_clause:
-            s.on_else(false);
-            break;
-        case template_command::end:
-            s.on_end(end);
+        case template_op::loop_end:
+            if (s.next_iteration(instr.loop))
+                ip = instr.target;
             break;
 
-        case template_command::invalid:
-            assert(false);
+        case template_op::branch:
+        {
+            auto entity = s.lookup_var(instr.entity);
+            if (!entity || !get_if_value(s, instr, entity))
+                ip = instr.target;
+            break;
         }
-    };
-    parse_commands(*p.get_logger(), p.get_template_config(), input.text.c_str(), handle,
-                   [&](const char* begin, const char* end) {
-                       if (!end)
-                           s.get_buffer() += begin;
-                       else
-                           s.get_buffer().append(begin, end - begin);
-                   });
-    return raw_document(input.output_name, s.get_buffer());
+        case template_op::jump:
+            ip = instr.target;
+            break;
+        }
+    }
+}
+
+raw_document standardese::process_template(const parser& p, const index& i,
+                                           const compiled_template& templ,
+                                           output_format_base*      default_format,
+                                           const documentation*     doc_file)
+{
+    string_output output;
+    process_template(output, p, i, templ, default_format, doc_file);
+    return raw_document(templ.get_output_name(), output.get_string());
+}
+
+raw_document standardese::process_template(const parser& p, const index& i,
+                                           const template_file& input,
+                                           output_format_base*  default_format,
+                                           const documentation* doc_file)
+{
+    return process_template(p, i, compiled_template(p, input), default_format, doc_file);
 }
@@ -12,12 +12,25 @@
 #include <standardese/detail/tokenizer.hpp>
 #include <standardese/detail/wrapper.hpp>
 #include <standardese/comment.hpp>
+#include <standardese/cpp_preprocessor.hpp>
 #include <standardese/cpp_template.hpp>
 #include <standardese/error.hpp>
 #include <standardese/parser.hpp>
 
 using namespace standardese;
 
+cpp_file::cpp_file(cpp_name path)
+: cpp_entity(get_entity_type(), clang_getNullCursor()), path_(std::move(path))
+{
+}
+
+cpp_file::~cpp_file() STANDARDESE_NOEXCEPT
+{
+    // the entities live in the arena, so destroy them before it is gone
+    while (!empty())
+        remove_entity_after(nullptr);
+}
+
 const parser& translation_unit::get_parser() const STANDARDESE_NOEXCEPT
 {
     return *parser_;
@@ -76,9 +89,26 @@ translation_unit::translation_unit(const parser& par, const char* path, cpp_file
 {
     detail::scope_stack stack(file_);
 
+    // entities are only visible to others once the whole file is parsed
+    cpp_entity_registry::entity_map entities;
     detail::visit_tu(get_cxunit(), get_cxfile(), [&](cpp_cursor cur, cpp_cursor parent) {
         stack.pop_if_needed(parent);
 
+        if (clang_getCursorKind(cur) == CXCursor_MacroDefinition)
+        {
+            // preprocessed source keeps the definitions of the file,
+            // line is already the line in it
+            unsigned line;
+            clang_getSpellingLocation(clang_getCursorLocation(cur), nullptr, &line, nullptr,
+                                      nullptr);
+
+            auto macro =
+                cpp_macro_definition::parse(get_cxunit(), get_cxfile(), cur, *file_, line);
+            if (macro)
+                file_->add_entity(std::move(macro));
+            return CXChildVisit_Continue;
+        }
+
         if (clang_getCursorSemanticParent(cur) != parent
             && clang_getCursorSemanticParent(cur) != cpp_cursor())
             // out of class definition, some weird other stuff with extern templates, implicit dtors
@@ -103,7 +133,7 @@ translation_unit::translation_unit(const parser& par, const char* path, cpp_file
             if (!entity)
                 return CXChildVisit_Continue;
 
-            get_parser().get_entity_registry().register_entity(*entity);
+            entities.emplace(entity->get_cursor(), entity.get());
 
             auto container = stack.add_entity(std::move(entity), parent);
             if (container)
@@ -126,4 +156,6 @@ translation_unit::translation_unit(const parser& par, const char* path, cpp_file
             return CXChildVisit_Continue;
         }
     });
+
+    get_parser().get_entity_registry().register_entities(get_cxunit(), std::move(entities));
 }
@@ -0,0 +1,322 @@
+// Copyright (C) 2016 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+// The benchmarks are hidden, run them with `standardese_test [benchmark]`.
+// Results are reported as warnings.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include <catch.hpp>
+#include <spdlog/fmt/fmt.h>
+
+#include <standardese/cpp_class.hpp>
+#include <standardese/output_stream.hpp>
+
+#include "test_parser.hpp"
+
+using namespace standardese;
+
+namespace
+{
+    std::atomic<std::size_t> allocation_count(0);
+
+    class stopwatch
+    {
+    public:
+        stopwatch() : start_(std::chrono::steady_clock::now())
+        {
+        }
+
+        double milliseconds() const
+        {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                             - start_)
+                .count();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // in MiB, 0 if not supported
+    std::size_t get_peak_rss()
+    {
+#if defined(__APPLE__)
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return std::size_t(usage.ru_maxrss) / (1024u * 1024u);
+#elif defined(__unix__)
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return std::size_t(usage.ru_maxrss) / 1024u;
+#else
+        return 0u;
+#endif
+    }
+}
+
+// counts the allocations of the whole test executable
+void* operator new(std::size_t size)
+{
+    ++allocation_count;
+    if (auto memory = std::malloc(size ? size : 1u))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) STANDARDESE_NOEXCEPT
+{
+    std::free(ptr);
+}
+
+TEST_CASE("benchmark_entity_allocation", "[.benchmark]")
+{
+    std::string code;
+    for (auto i = 0; i != 2000; ++i)
+        code += fmt::format(R"(namespace ns_{0}
+{{
+    /// A class.
+    struct class_with_a_rather_long_name_{0}
+    {{
+        int member_variable_{0};
+
+        void member_function_{0}(int first_parameter, const char* second_parameter) const;
+    }};
+
+    /// A function template.
+    template <typename T>
+    T function_template_with_a_long_name_{0}(const T& value) noexcept(noexcept(T(value)));
+}}
+)",
+                            i);
+
+    auto      allocations_before = allocation_count.load();
+    stopwatch watch;
+    {
+        parser p(test_logger);
+        auto   tu = parse(p, "benchmark_entity_allocation.cpp", code.c_str());
+        REQUIRE(!tu.get_file().empty());
+    }
+    auto time        = watch.milliseconds();
+    auto allocations = allocation_count.load() - allocations_before;
+
+    WARN(fmt::format("parsed and destroyed 2000 namespaces in {:.0f}ms: {} allocations, "
+                     "peak RSS {}MiB",
+                     time, allocations, get_peak_rss()));
+}
+
+TEST_CASE("benchmark_skip_function_bodies", "[.benchmark]")
+{
+    std::string code = R"(#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+)";
+    for (auto i = 0; i != 500; ++i)
+        code += fmt::format(R"(namespace ns_{0}
+{{
+    template <typename T, int N>
+    struct array_{0}
+    {{
+        T data[N];
+
+        template <typename Func>
+        void for_each(Func f) const
+        {{
+            for (auto i = 0; i != N; ++i)
+                f(data[i]);
+        }}
+
+        T sum() const
+        {{
+            T result{{}};
+            for_each([&](const T& value) {{ result += value; }});
+            return result;
+        }}
+    }};
+
+    inline double use_{0}()
+    {{
+        array_{0}<double, 4> a{{}};
+        array_{0}<int, 8>    b{{}};
+        return a.sum() + b.sum();
+    }}
+}}
+)",
+                            i);
+    std::ofstream("benchmark_skip_function_bodies.cpp") << code;
+
+    auto parse_time = [](bool parse_bodies) {
+        auto config = get_compile_config();
+        config.set_parse_function_bodies(parse_bodies);
+
+        parser    p(test_logger);
+        stopwatch watch;
+        p.parse("benchmark_skip_function_bodies.cpp", config);
+        return watch.milliseconds();
+    };
+    auto with_bodies    = parse_time(true);
+    auto without_bodies = parse_time(false);
+
+    WARN(fmt::format("parsed 500 class templates in {:.0f}ms with function bodies, "
+                     "{:.0f}ms without",
+                     with_bodies, without_bodies));
+}
+
+TEST_CASE("benchmark_extent", "[.benchmark]")
+{
+    // declarations where the extent reported by libclang needs to be fixed
+    std::string code;
+    for (auto i = 0; i != 200; ++i)
+        code += fmt::format(R"(namespace ns_{0}
+{{
+    struct type_{0}
+    {{
+        type_{0}() = default;
+        type_{0}(const type_{0}&)            = delete;
+        type_{0}& operator=(const type_{0}&) = delete;
+        ~type_{0}() noexcept(noexcept(int(0)) && sizeof(int) == 4) = default;
+
+        virtual void pure_function(int first, int second, int third) const = 0;
+
+        auto trailing_return(int first, const char* second, double third) const
+            -> decltype(first + third);
+
+        void noexcept_expression(int first, int second)
+            noexcept(noexcept(first + second) && noexcept(first * second));
+    }};
+
+    template <typename T>
+    auto function_template(const T& a, const T& b) noexcept(noexcept(a + b)) -> decltype(a + b);
+
+    void deleted_function(int first, const char* second, double third) = delete;
+}}
+)",
+                            i);
+
+    parser    p(test_logger);
+    stopwatch watch;
+    auto      tu   = parse(p, "benchmark_extent.cpp", code.c_str());
+    auto      time = watch.milliseconds();
+
+    auto no_functions = 0u;
+    for_each(tu.get_file(), [&](const cpp_entity& e) {
+        if (e.get_entity_type() == cpp_entity::class_t)
+            for (auto& member : static_cast<const cpp_class&>(e))
+                no_functions += is_function_like(member.get_entity_type());
+        else
+            no_functions +=
+                is_function_like(e.get_entity_type()) || is_function_template(e.get_entity_type());
+    });
+    REQUIRE(no_functions == 200u * 9u);
+
+    WARN(fmt::format("parsed {} functions with extent fix-ups in {:.0f}ms", no_functions, time));
+}
+
+TEST_CASE("benchmark_entity_registry", "[.benchmark]")
+{
+    std::string code;
+    for (auto i = 0; i != 1000; ++i)
+        code += fmt::format(R"(struct type_{0}
+{{
+    int first_member;
+    int second_member;
+
+    void first_function();
+    void second_function();
+}};
+)",
+                            i);
+
+    parser p(test_logger);
+    auto   tu = parse(p, "benchmark_entity_registry.cpp", code.c_str());
+
+    auto&                   registry = p.get_entity_registry();
+    std::vector<cpp_cursor> cursors;
+    for_each(tu.get_file(), [&](const cpp_entity& e) {
+        REQUIRE(e.get_entity_type() == cpp_entity::class_t);
+        REQUIRE(registry.try_lookup(e.get_cursor()) == &e);
+        cursors.push_back(e.get_cursor());
+        for (auto& member : static_cast<const cpp_class&>(e))
+        {
+            REQUIRE(registry.try_lookup(member.get_cursor()) == &member);
+            cursors.push_back(member.get_cursor());
+        }
+    });
+
+    // all threads look up every entity a couple of times, like during type resolution
+    std::string result;
+    for (auto no_threads : {1u, 2u, 4u, 8u, 16u})
+    {
+        std::atomic<std::size_t> no_found(0u);
+
+        stopwatch                watch;
+        std::vector<std::thread> threads;
+        for (auto t = 0u; t != no_threads; ++t)
+            threads.emplace_back([&] {
+                auto found = 0u;
+                for (auto i = 0; i != 100; ++i)
+                    for (auto& cur : cursors)
+                        found += registry.try_lookup(cur) != nullptr;
+                no_found += found;
+            });
+        for (auto& thread : threads)
+            thread.join();
+        auto time = watch.milliseconds();
+
+        auto no_lookups = no_threads * 100u * cursors.size();
+        REQUIRE(no_found == no_lookups);
+        result += fmt::format("\n{} threads: {:.1f}M lookups/s", no_threads,
+                              no_lookups / time / 1000.0);
+    }
+
+    WARN("entity registry lookups:" + result);
+}
+
+TEST_CASE("benchmark_output_stream", "[.benchmark]")
+{
+    std::string line(79u, 'a');
+    line += '\n';
+
+    // writes 64MiB of lines, every other block of 16 lines is indented
+    auto write = [&](output_stream_base& out) {
+        for (auto i = 0u; i != 64u * 1024u * 1024u / line.size(); ++i)
+        {
+            if (i % 32u == 0u)
+                out.indent(4u);
+            else if (i % 32u == 16u)
+                out.unindent(4u);
+            out.write_str(line.c_str(), line.size());
+        }
+    };
+
+    stopwatch file_watch;
+    {
+        // includes the final flush
+        file_output out("benchmark_output_stream.txt");
+        write(out);
+    }
+    auto file_time = file_watch.milliseconds();
+
+    string_output out;
+    stopwatch     string_watch;
+    write(out);
+    auto string_time = string_watch.milliseconds();
+    REQUIRE(out.get_string().size() > 64u * 1024u * 1024u);
+
+    WARN(fmt::format("output stream throughput: file_output {:.0f}MiB/s, "
+                     "string_output {:.0f}MiB/s",
+                     64.0 * 1000.0 / file_time, 64.0 * 1000.0 / string_time));
+}
@@ -450,3 +450,22 @@ TEST_CASE("comment-matching", "[doc]")
         }
     }
 }
+
+TEST_CASE("comment_id", "[doc]")
+{
+    comment_id location("foo/a.hpp", 4u);
+    REQUIRE(location.is_location());
+    REQUIRE(location.file_name() == std::string("a.hpp"));
+    REQUIRE(location.line() == 4u);
+
+    // file names are interned, so ids of the same file share them
+    comment_id inline_location("bar/a.hpp", 2u, ".b");
+    REQUIRE(inline_location.is_inline_location());
+    REQUIRE(inline_location.file_name() == location.file_name());
+    REQUIRE(inline_location.inline_entity_name() == ".b");
+    REQUIRE(comment_id("a.cpp", 1u).file_name() != location.file_name());
+
+    comment_id name("ns::foo");
+    REQUIRE(name.is_name());
+    REQUIRE(name.unique_name() == "ns::foo");
+}
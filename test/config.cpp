@@ -0,0 +1,68 @@
+// Copyright (C) 2016 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <standardese/config.hpp>
+
+#include <algorithm>
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+#include <catch.hpp>
+
+using namespace standardese;
+
+namespace fs = boost::filesystem;
+
+namespace
+{
+    bool has_flag(const std::vector<const char*>& flags, const std::string& flag)
+    {
+        return std::find_if(flags.begin(), flags.end(), [&](const char* str) {
+                   return str == flag;
+               }) != flags.end();
+    }
+}
+
+TEST_CASE("compile_commands", "[cpp]")
+{
+    auto dir = fs::system_complete("compile_commands").normalize();
+    fs::create_directories(dir / "a");
+    fs::create_directories(dir / "b" / "detail");
+
+    std::ofstream(fs::path(dir / "compile_commands.json").string()) << R"([
+    {
+        "directory": ")" << dir.generic_string() << R"(",
+        "command": "c++ -c -o a.o -Iinclude_a -DA=1 a/a.cpp",
+        "file": "a/a.cpp"
+    },
+    {
+        "directory": ")" << dir.generic_string() << R"(",
+        "command": "c++ -c -o b.o -I include_b -DB -F frameworks -mllvm opt b/b.cpp",
+        "file": "b/b.cpp"
+    }
+])";
+
+    compile_config config(cpp_standard::cpp_14, dir.generic_string());
+
+    auto a = config.get_flags((dir / "a" / "a.cpp").generic_string().c_str());
+    REQUIRE(has_flag(a, "-I" + (dir / "include_a").generic_string()));
+    REQUIRE(has_flag(a, "-DA=1"));
+    REQUIRE(!has_flag(a, "-DB"));
+    REQUIRE(!has_flag(a, "-c"));
+    REQUIRE(!has_flag(a, "a.o"));
+
+    // headers get the flags of the nearest file
+    auto b = config.get_flags((dir / "b" / "detail" / "b.hpp").generic_string().c_str());
+    REQUIRE(has_flag(b, (dir / "include_b").generic_string()));
+    REQUIRE(has_flag(b, "-DB"));
+    REQUIRE(!has_flag(b, "-DA=1"));
+
+    // values of options are not mistaken for the input file
+    REQUIRE(has_flag(b, (dir / "frameworks").generic_string()));
+    REQUIRE(has_flag(b, "opt"));
+    REQUIRE(!has_flag(b, "b/b.cpp"));
+
+    // the standard is still used
+    REQUIRE(has_flag(b, "-std=c++14"));
+}
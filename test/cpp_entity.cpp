@@ -4,7 +4,13 @@
 
 #include <standardese/cpp_entity.hpp>
 
+#include <mutex>
+#include <thread>
+
 #include <catch.hpp>
+#include <standardese/cpp_entity_registry.hpp>
+
+#include "test_parser.hpp"
 
 using namespace standardese;
 
@@ -73,3 +79,39 @@ TEST_CASE("cpp_entity", "[cpp]")
     REQUIRE(last == container.end());
     REQUIRE(!container.empty());
 }
+
+TEST_CASE("cpp_entity_registry", "[cpp]")
+{
+    parser p(test_logger);
+
+    const char* names[] = {"cpp_entity_registry_a", "cpp_entity_registry_b"};
+    for (auto name : names)
+        std::ofstream(name) << "struct foo {};\nint bar();\nnamespace ns { void baz(); }\n";
+
+    // parse both files concurrently
+    std::vector<translation_unit> tus;
+    std::mutex                    mutex;
+    std::vector<std::thread>      threads;
+    for (auto name : names)
+        threads.emplace_back([&, name] {
+            auto                        tu = p.parse(name, get_compile_config());
+            std::lock_guard<std::mutex> lock(mutex);
+            tus.push_back(std::move(tu));
+        });
+    for (auto& thread : threads)
+        thread.join();
+
+    auto& registry = p.get_entity_registry();
+    for (auto& tu : tus)
+    {
+        auto count = 0u;
+        for_each(tu.get_file(), [&](const cpp_entity& e) {
+            ++count;
+            REQUIRE(registry.try_lookup(e.get_cursor()) == &e);
+            REQUIRE(&registry.lookup_entity(e.get_cursor()) == &e);
+        });
+        REQUIRE(count == 3u);
+    }
+
+    REQUIRE(!registry.try_lookup(clang_getNullCursor()));
+}
@@ -1077,3 +1077,62 @@ TEST_CASE("implicit virtual", "[cpp]")
     });
     REQUIRE(count == 7u);
 }
+
+TEST_CASE("skipped function bodies", "[cpp]")
+{
+    auto code = R"(
+        template <typename T>
+        T a(T t) noexcept { return t; }
+
+        int b(int i) try { return i; } catch (...) { return 0; }
+
+        struct foo
+        {
+            foo(int i)
+            : i(i) { (void)0; }
+
+            int c() const { return i; }
+
+            auto d() -> int { return i; }
+
+            int e() const;
+
+            int i;
+        };
+    )";
+
+    std::ofstream("skipped_function_bodies") << code;
+
+    // describes all functions of the file
+    auto get_functions = [](bool parse_bodies) {
+        parser p(test_logger);
+
+        auto config = get_compile_config();
+        config.set_parse_function_bodies(parse_bodies);
+        auto tu = p.parse("skipped_function_bodies", config);
+
+        std::vector<std::string> result;
+        auto                     add = [&](const cpp_entity& e) {
+            auto func = get_function(e);
+            if (!func)
+                return;
+            result.push_back(std::string(func->get_full_name().c_str())
+                             + func->get_signature().c_str() + func->get_noexcept().c_str()
+                             + std::to_string(int(func->get_definition())));
+        };
+
+        for_each(tu.get_file(), [&](const cpp_entity& e) {
+            if (e.get_entity_type() == cpp_entity::class_t)
+                for (auto& member : static_cast<const cpp_class&>(e))
+                    add(member);
+            else
+                add(e);
+        });
+        return result;
+    };
+
+    auto skipped = get_functions(false);
+    auto parsed  = get_functions(true);
+    REQUIRE(skipped.size() == 6u);
+    REQUIRE(skipped == parsed);
+}
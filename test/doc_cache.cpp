@@ -0,0 +1,99 @@
+// Copyright (C) 2016 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <standardese/doc_cache.hpp>
+
+#include <catch.hpp>
+
+#include <standardese/doc_entity.hpp>
+#include <standardese/generator.hpp>
+#include <standardese/index.hpp>
+#include <standardese/output.hpp>
+
+#include "test_parser.hpp"
+
+using namespace standardese;
+
+namespace
+{
+    std::string read_text(const std::string& path)
+    {
+        std::ifstream file(path);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>{});
+    }
+}
+
+TEST_CASE("doc_cache", "[doc]")
+{
+    using standardese::index;
+
+    auto code = R"(
+        /// \module cached
+        /// A namespace.
+        namespace ns
+        {
+            /// A function.
+            /// \returns [bar]().
+            int foo(int a);
+
+            /// A class.
+            struct bar
+            {
+                /// A member.
+                int member;
+            };
+        }
+)";
+
+    parser p(test_logger);
+    auto   config = get_compile_config();
+
+    doc_cache cache("doc_cache", "test");
+    REQUIRE(!cache.lookup(p, index(), config, "doc_cache.hpp", "doc_cache").document);
+    REQUIRE(cache.get_miss_count() == 1u);
+
+    auto  tu = parse(p, "doc_cache.hpp", code);
+    index idx_a;
+    auto  doc_a = generate_doc_file(p, idx_a, tu.get_file(), "doc_cache");
+    cache.store(p, config, tu, "doc_cache", doc_a);
+
+    index idx_b;
+    auto  doc_b = cache.lookup(p, idx_b, config, "doc_cache.hpp", "doc_cache");
+    REQUIRE(doc_b.file);
+    REQUIRE(doc_b.document);
+    REQUIRE(cache.get_hit_count() == 1u);
+
+    REQUIRE(doc_b.document->get_output_name() == doc_a.document->get_output_name());
+    for (auto name : {"ns", "ns::foo(int)", "ns::foo(int).a", "ns::bar", "ns::bar::member"})
+    {
+        INFO(name);
+        auto a = idx_a.try_lookup(name);
+        auto b = idx_b.try_lookup(name);
+        REQUIRE(bool(a) == bool(b));
+        if (a)
+        {
+            REQUIRE(a->get_unique_name() == b->get_unique_name());
+            REQUIRE(a->get_index_name(true) == b->get_index_name(true));
+            REQUIRE(a->get_cpp_entity_type() == b->get_cpp_entity_type());
+            REQUIRE(a->get_module() == b->get_module());
+            REQUIRE(idx_a.get_linker().get_url(*a, "md") == idx_b.get_linker().get_url(*b, "md"));
+        }
+    }
+
+    auto urls = get_entity_urls(idx_a, *doc_a.document, "md");
+    REQUIRE(!urls.empty());
+
+    output_format_markdown format;
+    output(p, idx_a, "doc_cache_a_", format).render(test_logger, *doc_a.document);
+    output(p, idx_b, "doc_cache_b_", format).render(test_logger, *doc_b.document);
+    REQUIRE(read_text("doc_cache_a_doc_doc_cache.md") == read_text("doc_cache_b_doc_doc_cache.md"));
+
+    // rendering doesn't change the links of the document
+    REQUIRE(get_entity_urls(idx_a, *doc_a.document, "md") == urls);
+
+    // changing the file invalidates the entry
+    std::ofstream("doc_cache.hpp") << code << "\n/// Another class.\nstruct baz {};\n";
+    REQUIRE(!cache.lookup(p, index(), config, "doc_cache.hpp", "doc_cache").document);
+    REQUIRE(cache.get_miss_count() == 2u);
+}
@@ -6,6 +6,7 @@
 
 #include <catch.hpp>
 
+#include <standardese/generator.hpp>
 #include <standardese/index.hpp>
 
 #include "test_parser.hpp"
@@ -101,4 +102,77 @@ and a special one [here](doc_my_file.html#foo()) as well as one [here](doc_my_fi
         out.render_raw(p.get_logger(), doc);
         REQUIRE(get_text("other_file.md") == text_written);
     }
+    SECTION("generated again")
+    {
+        auto document = generate_doc_document(p, idx, *doc_entity);
+        REQUIRE(document->get_output_name() == "doc_my_file");
+
+        out.render(p.get_logger(), *document);
+        auto text = get_text("doc_my_file.html");
+        REQUIRE(text.find("A function.") != std::string::npos);
+        REQUIRE(text.find("A class.") != std::string::npos);
+    }
+    SECTION("frozen index")
+    {
+        REQUIRE(idx.try_lookup("foo()") == idx.try_lookup("foo"));
+        REQUIRE(idx.try_lookup("bar"));
+
+        idx.freeze();
+        idx.get_linker().freeze();
+        REQUIRE(idx.try_lookup("foo()") == idx.try_lookup("foo"));
+        REQUIRE(idx.try_lookup("foo ( )") == idx.try_lookup("foo"));
+        REQUIRE(idx.try_lookup("bar"));
+        REQUIRE(!idx.try_lookup("baz"));
+        REQUIRE(idx.get_linker().get_url(idx.lookup("bar"), "md") == "doc_my_file.md#bar");
+
+        auto text         = R"([foo](standardese://foo()/) and [bar](standardese://bar/))";
+        auto text_written = R"([foo](doc_my_file.html#foo()) and [bar](doc_my_file.html#bar))";
+
+        raw_document doc("frozen_file.md", text);
+        out.render_raw(p.get_logger(), doc);
+        REQUIRE(get_text("frozen_file.md") == text_written);
+    }
+}
+
+TEST_CASE("index")
+{
+    using standardese::index;
+
+    auto code = R"(
+        namespace ns
+        {
+            /// A class.
+            struct a
+            {
+                /// A function.
+                /// \param x A parameter.
+                void f(int x);
+
+                /// A member.
+                int m;
+            };
+        }
+)";
+
+    parser p(test_logger);
+    auto   tu = parse(p, "index", code);
+
+    index idx;
+    auto  doc = doc_file::parse(p, idx, "index", tu.get_file());
+
+    auto& f = idx.lookup("ns::a::f(int)");
+    auto& m = idx.lookup("ns::a::m");
+
+    auto check_lookup = [&] {
+        REQUIRE(idx.try_lookup("ns::a::f( int )") == &f);
+        REQUIRE(&idx.name_lookup(f, "?x") == idx.try_lookup("ns::a::f(int).x"));
+        REQUIRE(&idx.name_lookup(f, "?m") == &m);
+        REQUIRE(&idx.name_lookup(m, "*a") == idx.try_lookup("ns::a"));
+        REQUIRE(&idx.name_lookup(m, "ns") == idx.try_lookup("ns"));
+        REQUIRE(!idx.try_name_lookup(m, "?y"));
+    };
+
+    check_lookup();
+    idx.freeze();
+    check_lookup();
 }
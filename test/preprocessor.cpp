@@ -7,6 +7,8 @@
 #include <catch.hpp>
 
 #include <standardese/doc_entity.hpp>
+#include <standardese/cpp_variable.hpp>
+#include <standardese/preamble_cache.hpp>
 
 #include "test_parser.hpp"
 
@@ -88,3 +90,136 @@ TEST_CASE("cpp_macro_definition", "[cpp]")
     }
     REQUIRE(count == 6u);
 }
+
+TEST_CASE("preprocessor", "[cpp]")
+{
+    auto code = R"(
+        #define DECL(Name, ...) /** Name */ void Name(__VA_ARGS__);
+        #define CONCAT(a, b) a##b
+        #define STR(x) #x
+
+        DECL(a, int)
+        DECL(b)
+
+        #if 0
+        void c();
+        #endif
+
+        int CONCAT(d, e);
+        const char* f = STR(foo);
+        const char* g = STR( a+b  -  c );
+    )";
+
+    std::ofstream file("preprocessor");
+    file << code;
+    file.close();
+
+    auto get_names = [](bool external) {
+        parser p(test_logger);
+
+        auto config = get_compile_config();
+        config.set_external_preprocessor(external);
+        auto tu = p.parse("preprocessor", config);
+
+        std::vector<std::string> result;
+        for_each(tu.get_file(), [&](const cpp_entity& e) {
+            if (e.get_entity_type() == cpp_entity::macro_definition_t)
+                return;
+            result.push_back(e.get_name().c_str());
+            if (e.get_name() == "g")
+                REQUIRE(static_cast<const cpp_variable&>(e).get_initializer() == "\"a+b - c\"");
+            if (e.get_name() == "a" || e.get_name() == "b")
+                REQUIRE(p.get_comment_registry().lookup_comment(e, nullptr) != nullptr);
+        });
+        return result;
+    };
+
+    auto in_process = get_names(false);
+    REQUIRE(in_process == (std::vector<std::string>{"a", "b", "de", "f", "g"}));
+    REQUIRE(in_process == get_names(true));
+}
+
+TEST_CASE("preprocessor_redefinition", "[cpp]")
+{
+    std::ofstream header("preprocessor_redefinition.hpp");
+    header << R"(
+        #define H 1
+        #define HX H
+        #undef H
+    )";
+    header.close();
+
+    auto code = R"(
+        #include "preprocessor_redefinition.hpp"
+
+        #define A 1
+        #define B A
+        int a = B;
+
+        #undef A
+        #define A 2
+        int b = B;
+
+        #undef A
+        const int A = 3;
+        int c = B;
+
+        const int H = 4;
+        int d = HX;
+    )";
+
+    std::ofstream file("preprocessor_redefinition");
+    file << code;
+    file.close();
+
+    auto get_initializers = [](bool external) {
+        parser p(test_logger);
+
+        auto config = get_compile_config();
+        config.set_external_preprocessor(external);
+        auto tu = p.parse("preprocessor_redefinition", config);
+
+        std::vector<std::string> result;
+        for_each(tu.get_file(), [&](const cpp_entity& e) {
+            if (e.get_entity_type() == cpp_entity::variable_t)
+                result.push_back(static_cast<const cpp_variable&>(e).get_initializer());
+        });
+        return result;
+    };
+
+    auto in_process = get_initializers(false);
+    REQUIRE(in_process == (std::vector<std::string>{"1", "2", "3", "A", "4", "H"}));
+    REQUIRE(in_process == get_initializers(true));
+}
+
+TEST_CASE("preamble_cache", "[cpp]")
+{
+    parser p(test_logger);
+    p.enable_preamble_cache("preamble_cache");
+
+    auto code = R"(
+        #include <vector>
+
+        /// test
+        std::vector<int> test;
+    )";
+
+    for (auto name : {"preamble_a", "preamble_b", "preamble_c"})
+    {
+        auto tu = parse(p, name, code);
+
+        auto count = 0u;
+        for_each(tu.get_file(), [&](const cpp_entity& e) {
+            if (e.get_name() == "test")
+            {
+                ++count;
+                REQUIRE(p.get_comment_registry().lookup_comment(e, nullptr) != nullptr);
+            }
+        });
+        REQUIRE(count == 1u);
+    }
+
+    // first one doesn't use it
+    REQUIRE(p.get_preamble_cache()->get_miss_count() == 1u);
+    REQUIRE(p.get_preamble_cache()->get_hit_count() == 2u);
+}
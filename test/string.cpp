@@ -0,0 +1,88 @@
+// Copyright (C) 2016 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#include <standardese/string.hpp>
+
+#include <catch.hpp>
+
+#include <standardese/detail/memory_arena.hpp>
+
+#include <thread>
+#include <vector>
+
+using namespace standardese;
+
+TEST_CASE("interned_string")
+{
+    interned_string a("foo");
+    interned_string b(std::string("foobar").c_str(), 3u);
+    interned_string c("bar");
+
+    REQUIRE(a == b);
+    REQUIRE(a != c);
+    REQUIRE(a.c_str() == b.c_str());
+    REQUIRE(std::strcmp(a.c_str(), "foo") == 0);
+    REQUIRE(a.length() == 3u);
+    REQUIRE(std::hash<interned_string>()(a) == std::hash<interned_string>()(b));
+
+    SECTION("string")
+    {
+        string str(a);
+        REQUIRE(str == "foo");
+        REQUIRE(str.c_str() == a.c_str());
+
+        // copies refer to the pool as well
+        string copy(str);
+        REQUIRE(copy.c_str() == a.c_str());
+
+        copy = string(std::string("baz"));
+        REQUIRE(copy == "baz");
+        copy = str;
+        REQUIRE(copy.c_str() == a.c_str());
+    }
+    SECTION("threads")
+    {
+        std::vector<const char*> results(4u * 100u);
+
+        std::vector<std::thread> threads;
+        for (auto t = 0u; t != 4u; ++t)
+            threads.emplace_back([&, t] {
+                for (auto i = 0u; i != 100u; ++i)
+                    results[t * 100u + i] = interned_string(std::to_string(i).c_str()).c_str();
+            });
+        for (auto& thread : threads)
+            thread.join();
+
+        for (auto i = 0u; i != results.size(); ++i)
+            REQUIRE(results[i] == interned_string(std::to_string(i % 100u).c_str()).c_str());
+    }
+}
+
+TEST_CASE("string_arena")
+{
+    detail::memory_arena       arena;
+    detail::memory_arena_scope scope(detail::arena_kind::cpp_entity, &arena);
+
+    auto long_str = "a string that doesn't fit into the buffer of std::string";
+
+    // not part of something in the arena
+    string str(long_str);
+    REQUIRE(str == long_str);
+    REQUIRE(!arena.in_current_block(str.c_str()));
+
+    // part of something in the arena, so the characters are stored there as well
+    auto member = ::new (arena.allocate(sizeof(string), alignof(string))) string(str);
+    REQUIRE(*member == long_str);
+    REQUIRE(arena.in_current_block(member->c_str()));
+
+    // copies outside of the arena don't refer to it
+    string copy(*member);
+    REQUIRE(copy == long_str);
+    REQUIRE(!arena.in_current_block(copy.c_str()));
+
+    *member = string("short");
+    REQUIRE(*member == "short");
+
+    member->~string();
+}
@@ -119,6 +119,25 @@ b,
 
         REQUIRE(process_template(p, idx, template_file("template.md", code)).text == generated);
     }
+    SECTION("compiled_template")
+    {
+        auto code = R"(
+{{ standardese_for $entity c }}{{ standardese_if $entity name f1() }}
+    {{ standardese_name $entity }}{{ standardese_end }}{{ standardese_end }}
+{{ other }}
+)";
+        auto generated = R"(
+
+    f1
+{{ other }}
+)";
+
+        compiled_template templ(p, template_file("template.md", code));
+        REQUIRE(templ.get_output_name() == "template.md");
+        REQUIRE(process_template(p, idx, templ).text == generated);
+        // can be processed again
+        REQUIRE(process_template(p, idx, templ).text == generated);
+    }
     SECTION("if")
     {
         auto code      = R"(
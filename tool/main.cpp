@@ -2,9 +2,15 @@
 // This file is subject to the license terms in the LICENSE file
 // found in the top-level directory of this distribution.
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <boost/filesystem.hpp>
@@ -14,16 +20,19 @@
 #include <spdlog/fmt/ostr.h>
 #include <spdlog/spdlog.h>
 
+#include <standardese/doc_cache.hpp>
 #include <standardese/error.hpp>
 #include <standardese/generator.hpp>
 #include <standardese/index.hpp>
 #include <standardese/output.hpp>
 #include <standardese/parser.hpp>
+#include <standardese/preamble_cache.hpp>
 #include <standardese/template_processor.hpp>
 
 #include "filesystem.hpp"
 #include "options.hpp"
 #include "thread_pool.hpp"
+#include "watcher.hpp"
 
 namespace fs = boost::filesystem;
 namespace po = boost::program_options;
@@ -51,10 +60,9 @@ void print_usage(const char* exe_name, const po::options_description& generic,
     std::clog << configuration << '\n';
 }
 
-template <typename Generator>
-std::vector<standardese::documentation> generate_documentation(
-    standardese::parser& parser, const po::variables_map& map, std::size_t no_threads,
-    std::vector<standardese::template_file>& templates, Generator generate)
+// calls f for each input file, like the traversal of the inputs in generate_documentation()
+template <typename Func>
+void for_each_input(const po::variables_map& map, Func f)
 {
     auto input              = map.at("input-files").as<std::vector<fs::path>>();
     auto source_ext         = map.at("input.source_ext").as<std::vector<std::string>>();
@@ -64,93 +72,397 @@ std::vector<standardese::documentation> generate_documentation(
     auto blacklist_dotfiles = map.at("input.blacklist_dotfiles").as<bool>();
     auto force_blacklist    = map.at("input.force_blacklist").as<bool>();
 
-    assert(!input.empty());
     for (auto& path : input)
-        parser.get_preprocessor().whitelist_include_dir(path.parent_path().generic_string());
+        standardese_tool::handle_path(path, source_ext, blacklist_ext, blacklist_file,
+                                      blacklist_dir, blacklist_dotfiles, force_blacklist, f);
+}
+
+template <typename Generator>
+std::vector<standardese::documentation> generate_documentation(
+    standardese::parser& parser, const po::variables_map& map, standardese_tool::thread_pool& pool,
+    std::vector<standardese::template_file>& templates, Generator generate)
+{
+    assert(!map.at("input-files").as<std::vector<fs::path>>().empty());
+
+    // collect all files first, so that the templates are known before generation
+    std::vector<std::pair<fs::path, fs::path>> source_files;
+    for_each_input(map, [&](bool is_source_file, const fs::path& p, const fs::path& relative) {
+        if (is_source_file)
+            source_files.emplace_back(p, relative);
+        else
+        {
+            std::ifstream file(p.generic_string());
+            if (!file.is_open())
+                parser.get_logger()->error("unable to open template file '{}", p.generic_string());
+            templates.emplace_back(standardese_tool::get_output_name(relative)
+                                       + relative.extension().generic_string(),
+                                   std::string(std::istreambuf_iterator<char>(file),
+                                               std::istreambuf_iterator<char>{}));
+        }
+    });
 
     std::vector<std::future<standardese::documentation>> futures;
-    futures.reserve(input.size());
+    futures.reserve(source_files.size());
 
     {
-        standardese_tool::thread_pool pool(no_threads);
-        for (auto& path : input)
-            standardese_tool::
-                handle_path(path, source_ext, blacklist_ext, blacklist_file, blacklist_dir,
-                            blacklist_dotfiles, force_blacklist,
-                            [&](bool is_source_file, const fs::path& p, const fs::path& relative) {
-                                if (is_source_file)
-                                    futures.push_back(
-                                        standardese_tool::add_job(pool, generate, p, relative));
-                                else
-                                {
-                                    std::ifstream file(p.generic_string());
-                                    if (!file.is_open())
-                                        parser.get_logger()
-                                            ->error("unable to open template file '{}",
-                                                    p.generic_string());
-                                    templates
-                                        .emplace_back(standardese_tool::get_output_name(relative)
-                                                          + relative.extension().generic_string(),
-                                                      std::
-                                                          string(std::istreambuf_iterator<char>(
-                                                                     file),
-                                                                 std::istreambuf_iterator<char>{}));
-                                }
-                            });
+        standardese_tool::task_group group(pool);
+        for (auto& file : source_files)
+            futures.push_back(group.run(generate, file.first, file.second));
     }
 
     std::vector<standardese::documentation> documentations;
     for (auto& f : futures)
     {
+        // the document might have been released
         auto doc = f.get();
-        if (doc.document)
+        if (doc.file)
             documentations.push_back(std::move(doc));
     }
 
     return documentations;
 }
 
+// creates an output for each format
+std::vector<standardese::output> get_outputs(const standardese_tool::configuration& config,
+                                             const standardese::index& idx, const fs::path& prefix)
+{
+    auto prefix_dir = prefix.parent_path();
+    if (!prefix_dir.empty())
+        fs::create_directories(prefix_dir);
+
+    std::vector<standardese::output> outputs;
+    for (auto& format : config.formats)
+        outputs.emplace_back(*config.parser, idx, prefix.generic_string(), *format);
+    return outputs;
+}
+
+template <typename Predicate>
 void write_output_files(const standardese_tool::configuration& config,
-                        const standardese::index& idx, std::size_t no_threads,
-                        const standardese::template_file* default_template, fs::path prefix,
+                        const standardese::index& idx, standardese_tool::thread_pool& pool,
+                        const standardese::compiled_template* default_template, fs::path prefix,
                         const std::vector<standardese::documentation>& documentations,
-                        const std::vector<standardese::raw_document>&  raw_documents)
+                        const std::vector<standardese::raw_document>&  raw_documents,
+                        Predicate                                      needs_rendering)
 {
     using namespace standardese;
 
+    auto&       logger = config.parser->get_logger();
+    std::string format_names;
     for (auto& format : config.formats)
     {
-        config.parser->get_logger()->info("Writing files for output format {}...",
-                                          format->extension());
-
-        auto prefix_dir = prefix.parent_path();
-        if (!prefix_dir.empty())
-            fs::create_directories(prefix_dir);
-
-        output out(*config.parser, idx, prefix.generic_string(), *format);
-        standardese_tool::for_each(no_threads, documentations,
-                                   [](const standardese::documentation& doc) {
-                                       return doc.document != nullptr;
-                                   },
-                                   [&](const standardese::documentation& doc) {
-                                       config.parser->get_logger()
-                                           ->debug("writing documentation file '{}'",
-                                                   doc.document->get_output_name());
-                                       if (default_template)
-                                           out.render_template(config.parser->get_logger(),
-                                                               *default_template, doc,
-                                                               config.link_extension());
-                                       else
-                                           out.render(config.parser->get_logger(), *doc.document,
-                                                      config.link_extension());
-                                   });
-        standardese_tool::for_each(no_threads, raw_documents,
-                                   [](const standardese::raw_document&) { return true; },
-                                   [&](const standardese::raw_document& doc) {
-                                       config.parser->get_logger()
-                                           ->debug("writing template file '{}'", doc.file_name);
-                                       out.render_raw(config.parser->get_logger(), doc);
+        if (!format_names.empty())
+            format_names += ", ";
+        format_names += format->extension();
+    }
+    logger->info("Writing files for output formats {}...", format_names);
+
+    auto outputs = get_outputs(config, idx, prefix);
+
+    // all documents and formats are written at once
+    standardese_tool::task_group group(pool);
+    for (auto& doc : documentations)
+    {
+        if (!doc.document && doc.file)
+            // the document was released after generation, it is generated again just for writing
+            group.run([&] {
+                try
+                {
+                    auto document = generate_doc_document(*config.parser, idx, *doc.file);
+                    logger->debug("writing documentation file '{}'",
+                                  document->get_output_name());
+                    output::render(logger, *document, outputs, config.link_extension());
+                }
+                catch (cmark_error& ex)
+                {
+                    logger->error("cmark error in '{}'", ex.what());
+                }
+            });
+        else if (!doc.document || !needs_rendering(doc))
+            continue;
+        else if (default_template)
+            for (auto& out : outputs)
+                group.run([&] {
+                    logger->debug("writing documentation file '{}'",
+                                  doc.document->get_output_name());
+                    out.render_template(logger, *default_template, doc, config.link_extension());
+                });
+        else
+            // a single job per document: its links are resolved in place, once for all formats
+            group.run([&] {
+                logger->debug("writing documentation file '{}'", doc.document->get_output_name());
+                output::render(logger, *doc.document, outputs, config.link_extension());
+            });
+    }
+    for (auto& doc : raw_documents)
+    {
+        // a template with its own extension is the same file for all formats,
+        // it must only be written once
+        std::unordered_set<std::string> extensions;
+        for (auto& out : outputs)
+        {
+            auto extension =
+                doc.file_extension.empty() ? out.get_format().extension() : doc.file_extension;
+            if (!extensions.insert(extension).second)
+                continue;
+
+            group.run([&] {
+                logger->debug("writing template file '{}'", doc.file_name);
+                out.render_raw(logger, doc);
+            });
+        }
+    }
+}
+
+// the state kept between the runs in watch mode
+struct watch_state
+{
+    // the URLs of the entity links in each documentation file that was written
+    std::unordered_map<std::string, std::vector<std::string>> urls;
+};
+
+// generates and writes the documentation of all inputs
+// in watch mode, documentation files are only written again
+// if they were regenerated or one of their links changed
+void generate_output(standardese_tool::configuration& config, standardese_tool::thread_pool& pool,
+                     standardese::doc_cache* cache, watch_state* state)
+{
+    using namespace standardese;
+
+    auto& parser         = *config.parser;
+    auto& compile_config = config.compile_config;
+    auto& map            = config.map;
+    auto  log            = parser.get_logger();
+    pool.reset_statistics();
+
+    standardese::index index;
+    config.set_external(index.get_linker());
+
+    std::vector<template_file> templates;
+
+    // the entities of cached files can't be used in templates
+    auto templ_path = map.at("template.default_template").as<std::string>();
+    auto use_cache  = [&] { return cache && templates.empty() && templ_path.empty(); };
+    auto hits       = cache ? cache->get_hit_count() : 0u;
+    auto misses     = cache ? cache->get_miss_count() : 0u;
+
+    // output names of the documentation files that were not taken from the cache
+    std::mutex                      generated_mutex;
+    std::unordered_set<std::string> generated;
+
+    // without a default template and outside of watch mode,
+    // the documents aren't needed until they are written,
+    // so they are released after generation and generated again by the job that writes them
+    // only the entities stay alive for the index and the linker
+    auto prefix           = map.at("output.prefix").as<std::string>();
+    auto release_document = !state && templ_path.empty();
+
+    // generate documentations
+    auto generate_file = [&](const fs::path& p, const fs::path& relative) {
+        standardese::documentation result(nullptr, nullptr);
+        try
+        {
+            auto output_name = standardese_tool::get_output_name(relative);
+            if (use_cache())
+            {
+                result = cache->lookup(parser, index, compile_config, p.generic_string().c_str(),
+                                       output_name);
+                if (result.document)
+                {
+                    log->info("Using cached documentation for {}...", p);
+                    return result;
+                }
+            }
+
+            log->info("Generating documentation for {}...", p);
+            auto tu = parser.parse(p.generic_string().c_str(), compile_config,
+                                   relative.generic_string().c_str());
+            result = generate_doc_file(parser, index, tu.get_file(), output_name);
+            if (cache)
+                cache->store(parser, compile_config, tu, output_name, result);
+
+            {
+                std::lock_guard<std::mutex> lock(generated_mutex);
+                generated.insert(result.document->get_output_name());
+            }
+            if (release_document)
+                result.document.reset();
+        }
+        catch (libclang_error& ex)
+        {
+            log->error("libclang error on {}", ex.what());
+        }
+        catch (cmark_error& ex)
+        {
+            log->error("cmark error in '{}'", ex.what());
+        }
+
+        return result;
+    };
+    auto documentations = generate_documentation(parser, map, pool, templates, generate_file);
+
+    // all entities are registered, lookups don't need to lock anymore
+    index.freeze();
+    if (auto preamble_cache = parser.get_preamble_cache())
+        log->info("Preamble cache: {} hits, {} misses", preamble_cache->get_hit_count(),
+                  preamble_cache->get_miss_count());
+    if (use_cache())
+        log->info("Documentation cache: {} hits, {} misses", cache->get_hit_count() - hits,
+                  cache->get_miss_count() - misses);
+    else if (cache)
+        log->info("Documentation cache only updated, templates need all entities");
+
+    std::unordered_set<const md_document*> unchanged;
+    if (state)
+    {
+        auto extension = config.link_extension() ? config.link_extension() :
+                                                   config.formats.front()->extension();
+        std::unordered_set<std::string> current;
+        for (auto& doc : documentations)
+        {
+            auto& name = doc.document->get_output_name();
+            auto  urls = get_entity_urls(index, *doc.document, extension);
+            current.insert(name);
+
+            auto iter = state->urls.find(name);
+            if (iter != state->urls.end() && iter->second == urls && generated.count(name) == 0u)
+                unchanged.insert(doc.document.get());
+            state->urls[name] = std::move(urls);
+        }
+        log->info("{} of {} documentation files are unchanged", unchanged.size(),
+                  documentations.size());
+
+        // remove the documentation of deleted inputs
+        for (auto iter = state->urls.begin(); iter != state->urls.end();)
+        {
+            if (current.count(iter->first) != 0u)
+            {
+                ++iter;
+                continue;
+            }
+
+            log->info("Removing documentation of deleted file '{}'...", iter->first);
+            for (auto& format : config.formats)
+            {
+                boost::system::error_code ec;
+                fs::remove(prefix + iter->first + '.' + format->extension(), ec);
+            }
+            iter = state->urls.erase(iter);
+        }
+    }
+
+    // generate indices
+    log->info("Generating indices...");
+    documentations.push_back(generate_file_index(index));
+    documentations.push_back(generate_entity_index(index));
+    documentations.push_back(generate_module_index(parser, index));
+
+    // process templates
+    auto raw_documents =
+        standardese_tool::for_each(pool, templates, [](const template_file&) { return true; },
+                                   [&](const template_file& f) {
+                                       log->info("Processing template file '{}'...",
+                                                 f.output_name);
+                                       return process_template(parser, index, f);
                                    });
+
+    // write output
+    auto needs_rendering = [&](const documentation& doc) {
+        return unchanged.count(doc.document.get()) == 0u;
+    };
+    if (templ_path.empty())
+    {
+        // templates can change the output files and add anchors, after that links are fixed
+        index.get_linker().freeze();
+        write_output_files(config, index, pool, nullptr, prefix, documentations,
+                           raw_documents, needs_rendering);
+    }
+    else
+    {
+        std::ifstream file(templ_path);
+        if (!file.is_open())
+            log->critical("unable to open template file '{}'", templ_path);
+        else
+        {
+            template_file input("", std::string(std::istreambuf_iterator<char>(file),
+                                                std::istreambuf_iterator<char>{}));
+            // parsed once and used for every documentation file
+            // the default template can change the output files and add anchors as well,
+            // so the linker keeps locking while it is rendered
+            compiled_template templ(parser, input);
+            write_output_files(config, index, pool, &templ, prefix, documentations,
+                               raw_documents, needs_rendering);
+        }
+        index.get_linker().freeze();
+    }
+    std::string utilization;
+    for (auto& stats : pool.get_statistics())
+        utilization += fmt::format("{}{:.0f}% ({} jobs)", utilization.empty() ? "" : ", ",
+                                   stats.utilization * 100.0, stats.no_jobs);
+    log->info("Worker utilization: {}", utilization);
+}
+
+// normalized paths of all input files
+std::set<fs::path> get_input_files(const po::variables_map& map)
+{
+    std::set<fs::path> result;
+    for_each_input(map, [&](bool, const fs::path& p, const fs::path&) {
+        result.insert(standardese_tool::get_normalized_path(p));
+    });
+    return result;
+}
+
+// regenerates the documentation whenever an input file changes
+//
+// every run starts with a new parser and index:
+// the entity, comment and link registries are append-only so that lookups don't need to lock,
+// so the entities of a changed file can't be replaced in place
+// unchanged files are loaded from the documentation cache instead of being parsed again,
+// and only documentation files whose content or links changed are written
+void watch(standardese_tool::configuration& config, standardese_tool::thread_pool& pool,
+           std::unique_ptr<standardese::doc_cache>& cache)
+{
+    auto log = config.parser->get_logger();
+    if (!cache)
+    {
+        // unchanged files are taken from the cache
+        auto dir = fs::temp_directory_path() / fs::unique_path("standardese-cache-%%%%-%%%%");
+        log->debug("caching documentation in '{}'", dir.generic_string());
+        cache.reset(new standardese::doc_cache(dir.generic_string(), config.cache_configuration));
+    }
+
+    auto&                          input = config.map.at("input-files").as<std::vector<fs::path>>();
+    standardese_tool::file_watcher watcher(input);
+    watch_state                    state;
+
+    auto inputs = get_input_files(config.map);
+    generate_output(config, pool, cache.get(), &state);
+    while (true)
+    {
+        log->info("Watching for changes...");
+        auto changed = watcher.wait();
+
+        auto new_inputs = get_input_files(config.map);
+        auto is_input   = [&](const fs::path& p) {
+            return inputs.count(p) != 0u || new_inputs.count(p) != 0u;
+        };
+        if (std::none_of(changed.begin(), changed.end(), is_input))
+            continue;
+        inputs = std::move(new_inputs);
+
+        auto start = std::chrono::steady_clock::now();
+        try
+        {
+            // new parser, so that nothing of the previous run remains
+            config.parser = config.make_parser();
+            generate_output(config, pool, cache.get(), &state);
+        }
+        catch (std::exception& ex)
+        {
+            log->error(ex.what());
+        }
+        auto duration = std::chrono::steady_clock::now() - start;
+        log->info("Updated documentation in {}ms",
+                  std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
     }
 }
 
@@ -167,7 +479,13 @@ int main(int argc, char* argv[])
             ("jobs,j", po::value<unsigned>()->default_value(standardese_tool::default_no_threads()),
              "sets the number of threads to use")
             ("color", po::value<bool>()->implicit_value(true)->default_value(true),
-             "enable/disable color support of logger");
+             "enable/disable color support of logger")
+            ("cache-dir", po::value<std::string>(),
+             "directory where the documentation of files is cached, unchanged files aren't parsed again")
+            ("watch,w", po::value<bool>()->implicit_value(true)->default_value(false),
+             "keeps running and updates the documentation whenever an input file changes, "
+             "each change runs the whole generation again: unchanged files are taken from the cache, "
+             "but with templates all files are parsed again");
 
     configuration.add_options()
             ("input.source_ext",
@@ -222,6 +540,12 @@ int main(int argc, char* argv[])
              "set MSVC compatibility version to fake, 0 to disable (-fms-compatibility[-version])")
             ("compilation.clang_binary", po::value<std::string>(),
              "path to clang++ binary")
+            ("compilation.external_preprocessor", po::value<bool>()->implicit_value(true)->default_value(false),
+             "always preprocess with the clang++ binary, otherwise it is only used as fallback")
+            ("compilation.parse_function_bodies", po::value<bool>()->implicit_value(true)->default_value(false),
+             "parse function bodies, they are skipped by default as they do not affect the documentation")
+            ("compilation.preamble_cache", po::value<bool>()->implicit_value(true)->default_value(false),
+             "share precompiled headers between files starting with the same includes")
 
             ("comment.command_character", po::value<char>()->default_value('\\'),
              "character used to introduce special commands")
@@ -278,10 +602,8 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    auto& map            = config.map;
-    auto& parser         = *config.parser;
-    auto& compile_config = config.compile_config;
-    auto& log            = parser.get_logger();
+    auto& map = config.map;
+    auto  log = config.parser->get_logger();
 
     if (map.count("help"))
         print_usage(argv[0], generic, configuration);
@@ -300,74 +622,17 @@ int main(int argc, char* argv[])
             log->debug("Using libclang version: {}", string(clang_getClangVersion()).c_str());
             log->debug("Using cmark version: {}", CMARK_VERSION_STRING);
 
-            auto               no_threads = map.at("jobs").as<unsigned>();
-            standardese::index index;
-            config.set_external(index.get_linker());
-
-            // generate documentations
-            auto generate = [&](const fs::path& p, const fs::path& relative) {
-                log->info("Generating documentation for {}...", p);
+            std::unique_ptr<doc_cache> cache;
+            if (map.count("cache-dir"))
+                cache.reset(new doc_cache(map.at("cache-dir").as<std::string>(),
+                                          config.cache_configuration));
 
-                standardese::documentation result(nullptr, nullptr);
-                try
-                {
-                    auto output_name = standardese_tool::get_output_name(relative);
-
-                    auto tu = parser.parse(p.generic_string().c_str(), compile_config,
-                                           relative.generic_string().c_str());
-                    result = generate_doc_file(parser, index, tu.get_file(), output_name);
-                }
-                catch (libclang_error& ex)
-                {
-                    log->error("libclang error on {}", ex.what());
-                }
-                catch (cmark_error& ex)
-                {
-                    log->error("cmark error in '{}'", ex.what());
-                }
-
-                return result;
-            };
-
-            std::vector<template_file> templates;
-            auto                       documentations =
-                generate_documentation(parser, map, no_threads, templates, generate);
-
-            // generate indices
-            log->info("Generating indices...");
-            documentations.push_back(generate_file_index(index));
-            documentations.push_back(generate_entity_index(index));
-            documentations.push_back(generate_module_index(parser, index));
-
-            // process templates
-            auto raw_documents =
-                standardese_tool::for_each(no_threads, templates,
-                                           [](const template_file&) { return true; },
-                                           [&](const template_file& f) {
-                                               log->info("Processing template file '{}'...",
-                                                         f.output_name);
-                                               return process_template(parser, index, f);
-                                           });
-
-            // write output
-            auto templ_path = map.at("template.default_template").as<std::string>();
-            auto prefix     = map.at("output.prefix").as<std::string>();
-            if (templ_path.empty())
-                write_output_files(config, index, no_threads, nullptr, prefix, documentations,
-                                   raw_documents);
+            // the threads are shared by all phases and all runs in watch mode
+            standardese_tool::thread_pool pool(map.at("jobs").as<unsigned>());
+            if (map.at("watch").as<bool>())
+                watch(config, pool, cache);
             else
-            {
-                std::ifstream file(templ_path);
-                if (!file.is_open())
-                    log->critical("unable to open template file '{}'", templ_path);
-                else
-                {
-                    template_file templ("", std::string(std::istreambuf_iterator<char>(file),
-                                                        std::istreambuf_iterator<char>{}));
-                    write_output_files(config, index, no_threads, &templ, prefix, documentations,
-                                       raw_documents);
-                }
-            }
+                generate_output(config, pool, cache.get(), nullptr);
         }
         catch (std::exception& ex)
         {
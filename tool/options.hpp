@@ -5,6 +5,10 @@
 #ifndef STANDARDESE_OPTIONS_HPP_INCLUDED
 #define STANDARDESE_OPTIONS_HPP_INCLUDED
 
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
 #include <boost/program_options.hpp>
 #include <boost/filesystem.hpp>
 #include <spdlog/spdlog.h>
@@ -94,6 +98,10 @@ namespace standardese_tool
         if (binary != map.end())
             result.set_clang_binary(binary->second.as<std::string>());
 
+        result.set_external_preprocessor(map.at("compilation.external_preprocessor").as<bool>());
+        result.set_parse_function_bodies(
+            map.at("compilation.parse_function_bodies").as<bool>());
+
         return result;
     }
 
@@ -147,8 +155,13 @@ namespace standardese_tool
         const boost::program_options::parsed_options& cmd_result,
         const boost::program_options::parsed_options& file_result)
     {
-        auto log = spdlog::stdout_logger_mt("standardese_log", map.at("color").as<bool>());
-        log->set_pattern("[%l] %v");
+        // watch mode creates a new parser for each run
+        auto log = spdlog::get("standardese_log");
+        if (!log)
+        {
+            log = spdlog::stdout_logger_mt("standardese_log", map.at("color").as<bool>());
+            log->set_pattern("[%l] %v");
+        }
         if (map.at("verbose").as<bool>())
             log->set_level(spdlog::level::debug);
 
@@ -156,10 +169,19 @@ namespace standardese_tool
         detail::handle_unparsed_options(*p, cmd_result);
         detail::handle_unparsed_options(*p, file_result);
 
+        if (map.at("compilation.preamble_cache").as<bool>())
+            p->enable_preamble_cache(
+                (fs::temp_directory_path() / fs::unique_path("standardese-%%%%-%%%%-%%%%"))
+                    .generic_string());
+
         auto dirs = map.find("compilation.preprocess_dir");
         if (dirs != map.end())
             for (auto& dir : dirs->second.as<std::vector<std::string>>())
                 p->get_preprocessor().whitelist_include_dir(std::move(dir));
+        // the directories of the inputs as well
+        if (map.count("input-files"))
+            for (auto& path : map.at("input-files").as<std::vector<fs::path>>())
+                p->get_preprocessor().whitelist_include_dir(path.parent_path().generic_string());
 
         p->get_comment_config().set_command_character(
             map.at("comment.command_character").as<char>());
@@ -195,20 +217,95 @@ namespace standardese_tool
         return p;
     }
 
+    namespace detail
+    {
+        // options that don't affect the documentation generated for a single file
+        // the compilation flags of a file are part of the entry already
+        inline bool is_cache_neutral_option(const std::string& key)
+        {
+            static const char* const neutral[] =
+                {"config", "verbose", "jobs", "color", "cache-dir", "watch",
+                 // which files are documented
+                 "input-files", "input.source_ext", "input.blacklist_ext", "input.blacklist_file",
+                 "input.blacklist_dir", "input.blacklist_dotfiles",
+                 // how the documentation is written
+                 "output.format", "output.prefix", "output.width", "output.link_extension",
+                 // templates don't use the cache
+                 "template.default_template", "template.delimiter_begin",
+                 "template.delimiter_end",
+                 // only affects the speed
+                 "compilation.preamble_cache"};
+            return std::find(std::begin(neutral), std::end(neutral), key) != std::end(neutral)
+                   || key.compare(0, std::strlen("template.cmd_name_"), "template.cmd_name_")
+                          == 0;
+        }
+
+        inline void append_cache_configuration(
+            std::string& result, const boost::program_options::parsed_options& options)
+        {
+            for (auto& opt : options.options)
+            {
+                if (is_cache_neutral_option(opt.string_key))
+                    continue;
+
+                result += opt.string_key;
+                for (auto& value : opt.value)
+                    result += '\0' + value;
+                result += '\n';
+            }
+        }
+    } // namespace detail
+
+    // the string describing the configuration for the documentation cache
+    // the whitelisted directories are part of it,
+    // as they are derived from the input files, which aren't
+    inline std::string get_cache_configuration(
+        const boost::program_options::parsed_options& cmd_result,
+        const boost::program_options::parsed_options& file_result,
+        const standardese::preprocessor&              pp)
+    {
+        std::string result = std::to_string(STANDARDESE_VERSION_MAJOR) + '.'
+                             + std::to_string(STANDARDESE_VERSION_MINOR) + '\n';
+        result += standardese::string(clang_getClangVersion()).c_str();
+        result += '\n';
+
+        detail::append_cache_configuration(result, cmd_result);
+        detail::append_cache_configuration(result, file_result);
+
+        result += "whitelist";
+        for (auto& dir : pp.get_whitelisted_directories())
+            result += '\0' + dir;
+        result += '\n';
+        return result;
+    }
+
     struct configuration
     {
         std::vector<std::unique_ptr<standardese::output_format_base>> formats;
         std::unique_ptr<standardese::parser>                          parser;
         standardese::compile_config                                   compile_config;
         boost::program_options::variables_map                         map;
+        boost::program_options::parsed_options                        cmd_options, file_options;
+        std::string                                                   cache_configuration;
 
-        configuration() : compile_config(standardese::cpp_standard::cpp_14)
+        configuration()
+        : compile_config(standardese::cpp_standard::cpp_14),
+          cmd_options(nullptr),
+          file_options(nullptr)
         {
         }
 
         configuration(std::unique_ptr<standardese::parser> p, standardese::compile_config c,
-                      boost::program_options::variables_map m)
-        : parser(std::move(p)), compile_config(std::move(c)), map(std::move(m))
+                      boost::program_options::variables_map  m,
+                      boost::program_options::parsed_options cmd,
+                      boost::program_options::parsed_options file)
+        : parser(std::move(p)),
+          compile_config(std::move(c)),
+          map(std::move(m)),
+          cmd_options(std::move(cmd)),
+          file_options(std::move(file)),
+          cache_configuration(
+              get_cache_configuration(cmd_options, file_options, parser->get_preprocessor()))
         {
             using namespace standardese;
 
@@ -226,6 +323,12 @@ namespace standardese_tool
                 throw std::invalid_argument("number of threads must not be 0");
         }
 
+        // creates a new parser with the same options
+        std::unique_ptr<standardese::parser> make_parser() const
+        {
+            return get_parser(map, cmd_options, file_options);
+        }
+
         const char* link_extension() const
         {
             auto iter = map.find("output.link_extension");
@@ -294,7 +397,8 @@ namespace standardese_tool
         auto config = parse_config(map);
         auto parser = get_parser(map, cmd_result, file_result);
 
-        return {std::move(parser), std::move(config), std::move(map)};
+        return {std::move(parser), std::move(config), std::move(map), std::move(cmd_result),
+                std::move(file_result)};
     }
 } // namespace standardese_tool
 
@@ -5,40 +5,359 @@
 #ifndef STANDARDESE_THREAD_POOL_HPP_INCLUDED
 #define STANDARDESE_THREAD_POOL_HPP_INCLUDED
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
 #include <future>
-#include <vector>
+#include <memory>
+#include <mutex>
 #include <thread>
-
-#include <ThreadPool.h>
+#include <vector>
 
 namespace standardese_tool
 {
-    using thread_pool = ::ThreadPool;
-
     inline unsigned default_no_threads()
     {
         return std::max(std::thread::hardware_concurrency(), 1u);
     }
 
-    template <typename Fnc, typename... Args>
-    auto add_job(thread_pool& p, Fnc f, Args&&... args)
-        -> std::future<typename std::result_of<Fnc(Args...)>::type>
+    // a work-stealing scheduler, the threads live as long as the pool
+    // every worker has its own queue, jobs added by a worker go to its queue,
+    // other jobs to a shared queue
+    // idle workers take jobs from the shared queue or steal them from other workers
+    class thread_pool
     {
-        return p.enqueue(f, std::forward<Args>(args)...);
-    }
+    public:
+        struct worker_statistics
+        {
+            std::uint64_t no_jobs;
+            double        utilization; // fraction of the time spent in jobs
+        };
+
+        explicit thread_pool(std::size_t no_threads)
+        : start_(std::chrono::steady_clock::now()), pending_(0u), stop_(false)
+        {
+            if (no_threads == 0u)
+                no_threads = 1u;
+
+            workers_.reserve(no_threads);
+            for (auto i = 0u; i != no_threads; ++i)
+                workers_.emplace_back(new worker);
+            for (auto i = 0u; i != no_threads; ++i)
+                workers_[i]->thread = std::thread([this, i] { run_worker(i); });
+        }
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        // finishes all remaining jobs
+        ~thread_pool() noexcept
+        {
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex_);
+                stop_ = true;
+            }
+            sleep_cv_.notify_all();
+
+            for (auto& w : workers_)
+                w->thread.join();
+        }
+
+        std::size_t size() const noexcept
+        {
+            return workers_.size();
+        }
+
+        // resets the statistics, e.g. at the beginning of a new run
+        // must not be called while jobs are running
+        void reset_statistics() noexcept
+        {
+            start_ = std::chrono::steady_clock::now();
+            for (auto& w : workers_)
+            {
+                w->no_jobs = 0u;
+                w->busy_ns = 0u;
+            }
+        }
+
+        // returns the statistics since the pool was created or reset
+        std::vector<worker_statistics> get_statistics() const
+        {
+            auto lifetime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - start_)
+                                .count();
+
+            std::vector<worker_statistics> result;
+            for (auto& w : workers_)
+                result.push_back({w->no_jobs.load(),
+                                  lifetime ? double(w->busy_ns.load()) / lifetime : 0.0});
+            return result;
+        }
+
+    private:
+        using job = std::function<void()>;
+
+        struct worker
+        {
+            std::mutex                 mutex;
+            std::deque<job>            jobs;
+            std::atomic<std::uint64_t> no_jobs, busy_ns;
+            std::thread                thread;
+            unsigned                   depth; // > 0 while helping inside a job
+
+            worker() : no_jobs(0u), busy_ns(0u), depth(0u)
+            {
+            }
+        };
+
+        // the worker the current thread belongs to, if any
+        static worker*& current_worker() noexcept
+        {
+            static thread_local worker* w = nullptr;
+            return w;
+        }
+
+        void push(job j)
+        {
+            // count it first, so that the counter never underflows
+            ++pending_;
+
+            auto index = get_worker_index();
+            if (index != workers_.size())
+            {
+                auto&                       self = *workers_[index];
+                std::lock_guard<std::mutex> lock(self.mutex);
+                self.jobs.push_back(std::move(j));
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lock(shared_mutex_);
+                shared_jobs_.push_back(std::move(j));
+            }
+
+            // lock, so that a worker can't miss the notification between check and wait
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            sleep_cv_.notify_one();
+        }
+
+        bool pop(std::size_t index, job& result)
+        {
+            // newest own job first, it is most likely still in the cache
+            {
+                auto&                       self = *workers_[index];
+                std::lock_guard<std::mutex> lock(self.mutex);
+                if (!self.jobs.empty())
+                {
+                    result = std::move(self.jobs.back());
+                    self.jobs.pop_back();
+                    return true;
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(shared_mutex_);
+                if (!shared_jobs_.empty())
+                {
+                    result = std::move(shared_jobs_.front());
+                    shared_jobs_.pop_front();
+                    return true;
+                }
+            }
+
+            // steal the oldest job of someone else, it is most likely the biggest one
+            for (auto i = 1u; i != workers_.size(); ++i)
+            {
+                auto&                       other = *workers_[(index + i) % workers_.size()];
+                std::lock_guard<std::mutex> lock(other.mutex);
+                if (!other.jobs.empty())
+                {
+                    result = std::move(other.jobs.front());
+                    other.jobs.pop_front();
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        // runs one job, returns false if there was none
+        bool run_one(std::size_t index)
+        {
+            job j;
+            if (!pop(index, j))
+                return false;
+            --pending_;
+
+            auto& self = *workers_[index];
+            ++self.no_jobs;
+            if (self.depth++ != 0u)
+                // nested job, time is already measured by the outer one
+                j();
+            else
+            {
+                auto start = std::chrono::steady_clock::now();
+                j();
+                auto duration = std::chrono::steady_clock::now() - start;
+                self.busy_ns +=
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+            }
+            --self.depth;
+            return true;
+        }
+
+        // runs jobs until done() returns true and sleeps while there are none
+        // whoever makes done() true must call wake_all() afterwards
+        template <typename Predicate>
+        void help_until(std::size_t index, const Predicate& done)
+        {
+            while (!done())
+            {
+                if (run_one(index))
+                    continue;
+
+                std::unique_lock<std::mutex> lock(sleep_mutex_);
+                sleep_cv_.wait(lock, [&] { return pending_ != 0u || done(); });
+            }
+        }
+
+        void wake_all()
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex_);
+            sleep_cv_.notify_all();
+        }
+
+        void run_worker(std::size_t index)
+        {
+            current_worker() = workers_[index].get();
+            while (true)
+            {
+                if (run_one(index))
+                    continue;
+
+                std::unique_lock<std::mutex> lock(sleep_mutex_);
+                if (pending_ == 0u && stop_)
+                    break;
+                sleep_cv_.wait(lock, [&] { return pending_ != 0u || stop_; });
+            }
+        }
+
+        // returns the index of the worker the current thread is, or size() if it isn't one
+        std::size_t get_worker_index() const noexcept
+        {
+            auto self = current_worker();
+            for (auto i = 0u; i != workers_.size(); ++i)
+                if (workers_[i].get() == self)
+                    return i;
+            return workers_.size();
+        }
+
+        std::vector<std::unique_ptr<worker>> workers_;
+        std::chrono::steady_clock::time_point start_;
+
+        std::mutex      shared_mutex_;
+        std::deque<job> shared_jobs_;
+
+        std::mutex               sleep_mutex_;
+        std::condition_variable  sleep_cv_;
+        std::atomic<std::size_t> pending_; // jobs that are queued but not started
+        bool                     stop_;
+
+        friend class task_group;
+    };
+
+    // a set of jobs that can be waited for
+    // groups can be nested: a job can create a group and wait for it,
+    // the worker then runs other jobs in the meantime
+    class task_group
+    {
+    public:
+        explicit task_group(thread_pool& pool) noexcept : pool_(&pool), pending_(0u)
+        {
+        }
+
+        task_group(const task_group&) = delete;
+        task_group& operator=(const task_group&) = delete;
+
+        ~task_group() noexcept
+        {
+            wait();
+        }
+
+        template <typename Fnc, typename... Args>
+        auto run(Fnc f, Args&&... args)
+            -> std::future<typename std::result_of<Fnc(Args...)>::type>
+        {
+            using result_type = typename std::result_of<Fnc(Args...)>::type;
+
+            auto task = std::make_shared<std::packaged_task<result_type()>>(
+                std::bind(std::move(f), std::forward<Args>(args)...));
+            auto result = task->get_future();
+
+            ++pending_;
+            pool_->push([this, task] {
+                (*task)();
+                finish_job();
+            });
+
+            return result;
+        }
+
+        // waits until all jobs of the group are finished
+        void wait() noexcept
+        {
+            auto index = pool_->get_worker_index();
+            if (index == pool_->size())
+            {
+                // not a worker, just block
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [&] { return pending_ == 0u; });
+            }
+            else
+            {
+                // help, the worker is otherwise lost until the jobs finish
+                // while the remaining jobs run on other workers, it sleeps with the idle ones
+                pool_->help_until(index, [&] { return pending_ == 0u; });
+                // wait until finish_job() is done with the group
+                std::lock_guard<std::mutex> lock(mutex_);
+            }
+        }
+
+    private:
+        void finish_job() noexcept
+        {
+            // notify under the lock, the group may be destroyed as soon as it is released
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--pending_ == 0u)
+            {
+                cv_.notify_all();
+                pool_->wake_all();
+            }
+        }
+
+        thread_pool*             pool_;
+        std::mutex               mutex_;
+        std::condition_variable  cv_;
+        std::atomic<std::size_t> pending_;
+    };
 
+    // calls f for each element that satisfies p and waits for all of them
     template <typename Container, typename Predicate, typename Func>
-    auto for_each(std::size_t no_threads, const Container& cont, const Predicate& p, const Func& f)
+    auto for_each(thread_pool& pool, const Container& cont, const Predicate& p, const Func& f)
         -> typename std::enable_if<std::is_same<decltype(f(cont[0])), void>::value>::type
     {
-        thread_pool pool(no_threads);
+        task_group group(pool);
         for (auto& elem : cont)
             if (p(elem))
-                add_job(pool, f, std::ref(elem));
+                group.run(f, std::ref(elem));
     }
 
+    // calls f for each element that satisfies p and returns the results in order
     template <typename Container, typename Predicate, typename Func>
-    auto for_each(std::size_t no_threads, const Container& cont, const Predicate& p, const Func& f)
+    auto for_each(thread_pool& pool, const Container& cont, const Predicate& p, const Func& f)
         -> typename std::enable_if<!std::is_same<decltype(f(cont[0])), void>::value,
                                    std::vector<decltype(f(cont[0]))>>::type
     {
@@ -46,10 +365,10 @@ namespace standardese_tool
         futures.reserve(cont.size());
 
         {
-            thread_pool pool(no_threads);
+            task_group group(pool);
             for (auto& elem : cont)
                 if (p(elem))
-                    futures.push_back(add_job(pool, f, std::ref(elem)));
+                    futures.push_back(group.run(f, std::ref(elem)));
         }
 
         std::vector<decltype(f(cont[0]))> results;
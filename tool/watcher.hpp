@@ -0,0 +1,175 @@
+// Copyright (C) 2016 Jonathan Müller <jonathanmueller.dev@gmail.com>
+// This file is subject to the license terms in the LICENSE file
+// found in the top-level directory of this distribution.
+
+#ifndef STANDARDESE_WATCHER_HPP_INCLUDED
+#define STANDARDESE_WATCHER_HPP_INCLUDED
+
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#define STANDARDESE_TOOL_HAS_WATCHER 1
+#else
+#define STANDARDESE_TOOL_HAS_WATCHER 0
+#endif
+
+namespace standardese_tool
+{
+    namespace fs = boost::filesystem;
+
+    inline fs::path get_normalized_path(const fs::path& path)
+    {
+        return fs::system_complete(path).normalize();
+    }
+
+#if STANDARDESE_TOOL_HAS_WATCHER
+    // watches the given inputs for changes using inotify
+    // directories are watched recursively, for files their directory is watched
+    class file_watcher
+    {
+    public:
+        explicit file_watcher(const std::vector<fs::path>& inputs) : fd_(inotify_init1(IN_CLOEXEC))
+        {
+            if (fd_.get() < 0)
+                throw std::runtime_error("unable to initialize inotify");
+
+            for (auto& input : inputs)
+            {
+                auto path = get_normalized_path(input);
+                if (fs::is_directory(path))
+                    add_recursive_watch(path, nullptr);
+                else
+                    // editors often replace the file instead of writing to it
+                    add_watch(path.parent_path(), false);
+            }
+        }
+
+        // blocks until something changed
+        // returns the normalized paths of all changed files
+        std::set<fs::path> wait()
+        {
+            std::set<fs::path> result;
+            read_events(result);
+
+            // editors and build systems often write multiple files at once,
+            // so collect changes until nothing happens for a moment
+            pollfd fd{fd_.get(), POLLIN, 0};
+            while (poll(&fd, 1, 100) > 0)
+                read_events(result);
+
+            return result;
+        }
+
+    private:
+        class file_descriptor
+        {
+        public:
+            explicit file_descriptor(int fd) noexcept : fd_(fd)
+            {
+            }
+
+            file_descriptor(const file_descriptor&) = delete;
+            file_descriptor& operator=(const file_descriptor&) = delete;
+
+            ~file_descriptor() noexcept
+            {
+                if (fd_ >= 0)
+                    close(fd_);
+            }
+
+            int get() const noexcept
+            {
+                return fd_;
+            }
+
+        private:
+            int fd_;
+        };
+
+        struct watched_dir
+        {
+            fs::path path;
+            bool     recursive;
+        };
+
+        void add_watch(const fs::path& dir, bool recursive)
+        {
+            auto wd = inotify_add_watch(fd_.get(), dir.c_str(),
+                                        IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM
+                                            | IN_MOVED_TO);
+            if (wd >= 0)
+                dirs_[wd] = watched_dir{dir, recursive};
+        }
+
+        // watches the directory and all its subdirectories,
+        // the files already in it are changed if changed isn't nullptr
+        void add_recursive_watch(const fs::path& dir, std::set<fs::path>* changed)
+        {
+            add_watch(dir, true);
+
+            // the directory can be removed again while it is traversed
+            boost::system::error_code ec, status_ec;
+            auto end = fs::recursive_directory_iterator();
+            for (auto iter = fs::recursive_directory_iterator(dir, ec); !ec && iter != end;
+                 iter.increment(ec))
+                if (fs::is_directory(iter->path(), status_ec))
+                    add_watch(iter->path(), true);
+                else if (changed)
+                    // a new directory can be filled before the watch is added
+                    changed->insert(iter->path());
+        }
+
+        void read_events(std::set<fs::path>& changed)
+        {
+            alignas(inotify_event) char buffer[4096];
+
+            auto size = read(fd_.get(), buffer, sizeof(buffer));
+            if (size < 0)
+                throw std::runtime_error("unable to read inotify events");
+
+            for (auto ptr = buffer; ptr < buffer + size;)
+            {
+                auto event = reinterpret_cast<const inotify_event*>(ptr);
+                ptr += sizeof(inotify_event) + event->len;
+
+                auto iter = dirs_.find(event->wd);
+                if (iter == dirs_.end() || event->len == 0u)
+                    continue;
+
+                auto path = iter->second.path / event->name;
+                if (iter->second.recursive && (event->mask & IN_ISDIR)
+                    && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+                    add_recursive_watch(path, &changed);
+                changed.insert(std::move(path));
+            }
+        }
+
+        file_descriptor                      fd_;
+        std::unordered_map<int, watched_dir> dirs_;
+    };
+#else
+    class file_watcher
+    {
+    public:
+        explicit file_watcher(const std::vector<fs::path>&)
+        {
+            throw std::runtime_error("watch mode is only supported on Linux");
+        }
+
+        std::set<fs::path> wait()
+        {
+            return {};
+        }
+    };
+#endif
+} // namespace standardese_tool
+
+#endif // STANDARDESE_WATCHER_HPP_INCLUDED